@@ -7,60 +7,419 @@
 #include<iostream>
 #include<random>
 #include<limits>
+#include<cmath>
+#include<algorithm>
+#include<functional>
+#include<fstream>
+#include<future>
+#include<map>
+#include<cstdio>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<deque>
+#include<exception>
+#include<chrono>
+#include<memory>
+#include<sstream>
+#include<utility>
+#include<cctype>
 namespace UFSACL
 {
+    // temperature schedule of UltraFastSimulatedAnnealing::run(), temperatureDivider is the cooling factor of each schedule
+    enum CoolingSchedule
+    {
+        // temperature is divided by divider per iteration and multiplied by divider^2 after each improvement (default)
+        COOLING_REHEAT_ON_IMPROVEMENT = 0,
 
-    // abstract solver that takes user algorithm into OpenCL kernel and runs on thousands of (GPU/CPU) threads
-    // supports maximum 2 billion elements for (num paramters X num objects) [example: 1000 parameters for 2 million objects]
-    // NumObjects = number of clones of state-machine (that are computed in parallel)
-    // NumParameters = number of parameters to tune to minimize energy
-    // ParameterType = float or double
-    template<int NumParameters, int NumObjects, typename ParameterType = float>
-    struct UltraFastSimulatedAnnealing
+        // temperature is divided by divider per iteration
+        COOLING_EXPONENTIAL = 1,
+
+        // Lundy-Mees: T = T / (1 + b * T) with b = (divider - 1) / temperatureStart, slower than exponential at low temperatures
+        COOLING_LUNDY_MEES = 2,
+
+        // temperature is divided by a factor in [1 + (divider - 1) / 100, divider] that pushes measured acceptance ratio towards target acceptance ratio
+        // (slowest cooling while acceptance ratio is above target, temperature never grows so that run() always ends)
+        COOLING_ADAPTIVE_ACCEPTANCE = 3
+    };
+
+    // distribution of mutation steps (multiplied by temperature and optional per-parameter step scale) compiled into kernel
+    enum MutationDistribution
+    {
+        // uniform step in (-0.5, 0.5) with rare x10, x50, x250, x1250 jumps (default)
+        MUTATION_HEAVY_TAIL_UNIFORM = 0,
+
+        // gaussian step with standard deviation 0.5 (Box-Muller)
+        MUTATION_GAUSSIAN = 1,
+
+        // cauchy step with scale 0.5
+        MUTATION_CAUCHY = 2,
+
+        // symmetric Levy alpha-stable step with scale 0.5 (Chambers-Mallows-Stuck), alpha=2 is gaussian, alpha=1 is cauchy
+        MUTATION_LEVY_STABLE = 3
+    };
+
+    // delivers improved solutions to callback of run()
+    // queueCapacity = 0: callback is called inside annealing loop (synchronous)
+    // queueCapacity > 0: solutions are copied into a bounded queue and callback is called from a dispatcher thread, annealing loop does not wait for callback
+    // when queue is full (callback is slower than improvements), oldest queued solution is dropped so latest solution is always delivered
+    template<typename ParameterType>
+    struct CallbackDispatcher
+    {
+    private:
+        std::function<void(ParameterType*)> callback;
+        int numParameters;
+        size_t queueCapacity;
+        size_t numDropped;
+        bool stopping;
+        std::deque<std::vector<ParameterType>> solutions;
+        std::mutex syncPoint;
+        std::condition_variable condition;
+        std::exception_ptr callbackError;
+        std::thread dispatcher;
+
+        void dispatch()
+        {
+            while (true)
+            {
+                std::vector<ParameterType> solution;
+                {
+                    std::unique_lock<std::mutex> lock(syncPoint);
+                    condition.wait(lock, [&]() { return stopping || solutions.size() > 0; });
+                    if (solutions.size() == 0)
+                        return;
+                    solution = std::move(solutions.front());
+                    solutions.pop_front();
+                }
+
+                // after an error, remaining solutions are dropped
+                if (callbackError)
+                    continue;
+                try
+                {
+                    callback(solution.data());
+                }
+                catch (...)
+                {
+                    callbackError = std::current_exception();
+                }
+            }
+        }
+    public:
+        CallbackDispatcher(std::function<void(ParameterType*)> callbackPrm, int numParametersPrm, size_t queueCapacityPrm) :
+            callback(callbackPrm), numParameters(numParametersPrm), queueCapacity(queueCapacityPrm), numDropped(0), stopping(false)
+        {
+            if (queueCapacity > 0)
+                dispatcher = std::thread([this]() { dispatch(); });
+        }
+
+        CallbackDispatcher(const CallbackDispatcher&) = delete;
+        CallbackDispatcher& operator=(const CallbackDispatcher&) = delete;
+
+        // copies solution (asynchronous) or calls callback with it (synchronous)
+        void notify(ParameterType* parameters)
+        {
+            if (queueCapacity == 0)
+            {
+                callback(parameters);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(syncPoint);
+                if (solutions.size() >= queueCapacity)
+                {
+                    solutions.pop_front();
+                    numDropped++;
+                }
+                solutions.emplace_back(parameters, parameters + numParameters);
+            }
+            condition.notify_one();
+        }
+
+        // waits until all queued solutions are delivered, rethrows first exception of callback
+        // returns number of solutions that were dropped by coalescing
+        size_t finish()
+        {
+            if (dispatcher.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(syncPoint);
+                    stopping = true;
+                }
+                condition.notify_one();
+                dispatcher.join();
+            }
+            if (callbackError)
+            {
+                std::exception_ptr error = callbackError;
+                callbackError = nullptr;
+                std::rethrow_exception(error);
+            }
+            return numDropped;
+        }
+
+        ~CallbackDispatcher()
+        {
+            if (dispatcher.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(syncPoint);
+                    stopping = true;
+                }
+                condition.notify_one();
+                dispatcher.join();
+            }
+        }
+    };
+
+    // diagnostics of one iteration of run()
+    struct TraceEvent
+    {
+        // iterations since start of run()
+        size_t iteration;
+        int reheatsLeft;
+        double temperature;
+        double currentEnergy;
+        double bestEnergy;
+        // ratio of objects that found a lower energy than current energy, -1 when not measured (reheat-on-improvement schedule)
+        double acceptanceRatio;
+        // host-side time of iteration (launch, selection)
+        double iterationNanoSeconds;
+        // time of last computation of main kernel on each device
+        std::vector<double> deviceNanoSeconds;
+        // bytes copied between RAM and each device during iteration
+        std::vector<size_t> deviceBytes;
+    };
+
+    // fixed-capacity ring of trace events, oldest events are overwritten when it is full
+    // single writer (thread of run()) without locks, events are read after run() returns
+    struct TraceRing
     {
     private:
+        std::vector<TraceEvent> events;
+        size_t numWritten;
+    public:
+        TraceRing() :numWritten(0)
+        {
+        }
+
+        // capacity = 0 disables tracing
+        void reset(size_t capacity, int numDevices)
+        {
+            events.assign(capacity, TraceEvent());
+            for (auto& e : events)
+            {
+                e.deviceNanoSeconds.resize(numDevices);
+                e.deviceBytes.resize(numDevices);
+            }
+            numWritten = 0;
+        }
+
+        bool enabled() const
+        {
+            return events.size() > 0;
+        }
+
+        // storage of next event (overwrites oldest one when full)
+        TraceEvent& next()
+        {
+            TraceEvent& e = events[numWritten % events.size()];
+            numWritten++;
+            return e;
+        }
+
+        // events in order of writing (oldest first)
+        std::vector<TraceEvent> snapshot() const
+        {
+            std::vector<TraceEvent> result;
+            if (events.size() == 0)
+                return result;
+            const size_t first = numWritten > events.size() ? numWritten - events.size() : 0;
+            for (size_t i = first; i < numWritten; i++)
+                result.push_back(events[i % events.size()]);
+            return result;
+        }
+
+        void writeJson(std::string path, const std::vector<std::string>& deviceNames) const
+        {
+            std::ofstream file(path, std::ios::trunc);
+            if (!file)
+                throw std::invalid_argument(std::string("Error: could not open trace file ") + path);
+            file.precision(17);
+            file << "{\n  \"devices\": [";
+            for (size_t i = 0; i < deviceNames.size(); i++)
+                file << (i > 0 ? ", " : "") << "\"" << jsonEscaped(deviceNames[i]) << "\"";
+            file << "],\n  \"events\": [";
+            const std::vector<TraceEvent> list = snapshot();
+            for (size_t i = 0; i < list.size(); i++)
+            {
+                const TraceEvent& e = list[i];
+                file << (i > 0 ? "," : "") << "\n    {\"iteration\": " << e.iteration << ", \"reheatsLeft\": " << e.reheatsLeft
+                    << ", \"temperature\": " << jsonNumber(e.temperature) << ", \"currentEnergy\": " << jsonNumber(e.currentEnergy) << ", \"bestEnergy\": " << jsonNumber(e.bestEnergy)
+                    << ", \"acceptanceRatio\": " << jsonNumber(e.acceptanceRatio) << ", \"iterationNanoSeconds\": " << jsonNumber(e.iterationNanoSeconds) << ", \"deviceNanoSeconds\": [";
+                for (size_t j = 0; j < e.deviceNanoSeconds.size(); j++)
+                    file << (j > 0 ? ", " : "") << jsonNumber(e.deviceNanoSeconds[j]);
+                file << "], \"deviceBytes\": [";
+                for (size_t j = 0; j < e.deviceBytes.size(); j++)
+                    file << (j > 0 ? ", " : "") << e.deviceBytes[j];
+                file << "]}";
+            }
+            file << "\n  ]\n}\n";
+            if (!file)
+                throw std::invalid_argument(std::string("Error: could not write trace file ") + path);
+        }
+
+        // 1 row per event, device columns are numbered in order of device names
+        void writeCsv(std::string path, int numDevices) const
+        {
+            std::ofstream file(path, std::ios::trunc);
+            if (!file)
+                throw std::invalid_argument(std::string("Error: could not open trace file ") + path);
+            file.precision(17);
+            file << "iteration,reheats_left,temperature,current_energy,best_energy,acceptance_ratio,iteration_ns";
+            for (int j = 0; j < numDevices; j++)
+                file << ",device" << j << "_ns,device" << j << "_bytes";
+            file << "\n";
+            for (const TraceEvent& e : snapshot())
+            {
+                file << e.iteration << "," << e.reheatsLeft << "," << e.temperature << "," << e.currentEnergy << "," << e.bestEnergy << "," << e.acceptanceRatio << "," << e.iterationNanoSeconds;
+                for (int j = 0; j < numDevices; j++)
+                    file << "," << e.deviceNanoSeconds[j] << "," << e.deviceBytes[j];
+                file << "\n";
+            }
+            if (!file)
+                throw std::invalid_argument(std::string("Error: could not write trace file ") + path);
+        }
+    private:
+        // json has no inf/nan (energy of a state is max() before first evaluation)
+        static std::string jsonNumber(double value)
+        {
+            if (!std::isfinite(value))
+                return "null";
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.17g", value);
+            return text;
+        }
+
+        static std::string jsonEscaped(const std::string& text)
+        {
+            std::string result;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                    result += '\\';
+                if ((unsigned char)c >= 32)
+                    result += c;
+            }
+            return result;
+        }
+    };
+
+    // convergence of run(), element k of each array belongs to k-th iteration
+    struct ConvergenceTrace
+    {
+        // wall-clock time since start of run()
+        std::vector<double> seconds;
+        std::vector<size_t> iteration;
+        std::vector<double> temperature;
+        std::vector<double> bestEnergy;
+        // distribution of energies of all objects computed in iteration (subsampled estimates when multi-fidelity is used)
+        std::vector<double> populationMin;
+        std::vector<double> populationMedian;
+        std::vector<double> populationMax;
+
+        size_t size() const
+        {
+            return iteration.size();
+        }
+
+        void clear()
+        {
+            seconds.clear();
+            iteration.clear();
+            temperature.clear();
+            bestEnergy.clear();
+            populationMin.clear();
+            populationMedian.clear();
+            populationMax.clear();
+        }
+    };
+
+    // common part of all solvers: takes user algorithm (energy function, helper functions, user inputs) into OpenCL kernel and dispatches it to all devices
+    // each solver derives from this and generates its own kernel around the same user-code
+    // numObjects = number of clones of state-machine (that are computed in parallel)
+    // numParameters = number of parameters to tune to minimize energy
+    struct SolverBase
+    {
+    protected:
+        int numParameters;
+        int numObjects;
         std::string kernel;
         GPGPU::Computer computer;
-        GPGPU::HostParameter randomDataIn;
-        GPGPU::HostParameter energyOut;
-        GPGPU::HostParameter parameterIn;
-        GPGPU::HostParameter parameterOut;
-        GPGPU::HostParameter randomDataOut;
-        GPGPU::HostParameter temperatureIn;
         std::vector<GPGPU::HostParameter> userInputFullAccess;
         int numWorkGroupsToRun;
-        int workGroupThreads;
-        int numParametersItersPerWorkgroupWithUnused;
+        // size_t so that host-side buffer sizes and indices (objects x threads x parameters) do not overflow
+        size_t workGroupThreads;
+        size_t numParametersItersPerWorkgroupWithUnused;
         std::string constants;
-        ParameterType currentEnergy;
-        std::vector<ParameterType> currentParameters;
-        std::vector<ParameterType> bestParameters;
         std::string userInputs;
         std::string userInputsWithoutTypes;
         std::string userFunction;
         std::string funcMin;
-    public:
-        UltraFastSimulatedAnnealing(std::string funcToMinimize, int gpuThreadsPerObject = 256, int numGPUsToUse = 16) :computer(GPGPU::Computer::DEVICE_ALL, -1, 1, true, numGPUsToUse)
+        int mutationDistribution;
+        double levyAlpha;
+        std::vector<double> parameterStepScales;
+        GPGPU::HostParameter stepScaleIn;
+        GPGPU::HostParameter randomCounterIn;
+        unsigned int randomKey;
+        unsigned int randomCounter;
+        size_t callbackQueueCapacity;
+        TraceRing trace;
+        std::vector<size_t> traceTransferredBytes;
+        std::vector<double> traceDeviceNanoSeconds;
+        std::vector<size_t> traceDeviceBytes;
+
+        SolverBase(std::string funcToMinimize, int numParametersPrm, int numObjectsPrm, int gpuThreadsPerObject, int numGPUsToUse, int deviceSelection) :computer(deviceSelection, -1, 1, true, numGPUsToUse)
         {
+            numParameters = numParametersPrm;
+            numObjects = numObjectsPrm;
             workGroupThreads = gpuThreadsPerObject;
-            numWorkGroupsToRun = NumObjects;
+            numWorkGroupsToRun = numObjects;
 
-            if (NumParameters % workGroupThreads != 0)
-                numParametersItersPerWorkgroupWithUnused = (NumParameters / workGroupThreads) + 1;
+            if (numParameters % workGroupThreads != 0)
+                numParametersItersPerWorkgroupWithUnused = (numParameters / workGroupThreads) + 1;
             else
-                numParametersItersPerWorkgroupWithUnused = NumParameters / workGroupThreads;
+                numParametersItersPerWorkgroupWithUnused = numParameters / workGroupThreads;
 
-
-            currentParameters.resize(NumParameters);
-            bestParameters.resize(NumParameters);
             funcMin = funcToMinimize;
+            mutationDistribution = MUTATION_HEAVY_TAIL_UNIFORM;
+            levyAlpha = 1.5;
+            randomKey = 0;
+            randomCounter = 0;
+            callbackQueueCapacity = 0;
         }
 
-        void build()
+        // real value for a #define of kernel code (std::to_string keeps only 6 decimals)
+        static std::string kernelReal(double value)
         {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.17g", value);
+            return text;
+        }
 
+        // defines that are common for all kernels + user functions
+        // bufferMultiplier: number of per-object slabs of largest buffer per object (for example shards)
+        template<typename ParameterType>
+        void buildConstants(size_t bufferMultiplier = 1)
+        {
             constants = std::string(R"(
-            #define NumItems )") + std::to_string(NumParameters * NumObjects) + std::string(R"(
+            #define NumItems )") + std::to_string((size_t)numParameters * numObjects) + std::string(R"(
+        )");
+
+            // kernel indices are 64-bit only when largest buffer has more elements than int can index
+            const size_t largestBuffer = std::max((size_t)numParameters * numObjects, (size_t)numObjects * workGroupThreads * numParametersItersPerWorkgroupWithUnused) * bufferMultiplier;
+            constants += std::string(R"(
+            #define GPGPU_INDEX )") + std::string(largestBuffer > (size_t)std::numeric_limits<int>::max() ? "long" : "int") + std::string(R"(
         )");
             if constexpr (std::is_floating_point_v<ParameterType> && sizeof(ParameterType) == 4)
                 constants += std::string(R"(
@@ -75,36 +434,252 @@ namespace UFSACL
                     #define UIMAXFLOATINV (2.32830644e-10)
                 )");
 
+            // smallest power of 2 that is not less than WorkGroupThreads (for reductions)
+            size_t workGroupThreadsPow2 = 1;
+            while (workGroupThreadsPow2 < workGroupThreads)
+                workGroupThreadsPow2 *= 2;
             constants += std::string(R"(
             #define WorkGroupThreads )") + std::to_string(workGroupThreads) + std::string(R"(
+            #define WorkGroupThreadsPow2 )") + std::to_string(workGroupThreadsPow2) + std::string(R"(
+        )");
+
+            constants += std::string(R"(
+            #define NumParameters )") + std::to_string(numParameters) + std::string(R"(
         )");
 
             constants += std::string(R"(
-            #define NumParameters )") + std::to_string(NumParameters) + std::string(R"(
+            #define NumObjects )") + std::to_string(numObjects) + std::string(R"(
         )");
 
             constants += std::string(R"(
             #define NumParamsPerThread )") + std::to_string(numParametersItersPerWorkgroupWithUnused) + std::string(R"(
         )");
 
+            // type of parameters and energy in energy code (vector of candidates in thread-per-candidate kernels)
+            constants += std::string(R"(
+            #define CandidateReal GPGPU_REAL_VAL
+        )");
+
+            constants += std::string(R"(
+            #define MutationDistribution )") + std::to_string(mutationDistribution) + std::string(R"(
+            #define LevyAlpha ((GPGPU_REAL_VAL))") + kernelReal(levyAlpha) + std::string(R"()
+            #define UseParameterStepScales )") + std::to_string(parameterStepScales.size() > 0 ? 1 : 0) + std::string(R"(
+        )");
+
             constants += userFunction;
+        }
+
+        // extra kernel argument for per-parameter step scales
+        std::string mutationArguments() const
+        {
+            return parameterStepScales.size() > 0 ? std::string(", global GPGPU_REAL_VAL * stepScaleIn") : std::string();
+        }
+
+        // creates per-parameter step scale input (if used), called after compile
+        template<typename ParameterType>
+        void createMutationInputs()
+        {
+            if (parameterStepScales.size() > 0)
+            {
+                stepScaleIn = computer.createArrayInput<ParameterType>("stepScaleIn", numParameters);
+                for (int i = 0; i < numParameters; i++)
+                    stepScaleIn.access<ParameterType>(i) = parameterStepScales[i];
+            }
+        }
+
+        GPGPU::HostParameter bindMutationInputs(GPGPU::HostParameter kernelParams)
+        {
+            if (parameterStepScales.size() > 0)
+                return kernelParams.next(stepScaleIn);
+            return kernelParams;
+        }
+
+        // iteration counter and key of counter-based random number generator (2 values, same for all work-items), called after compile
+        void createRandomInputs()
+        {
+            randomCounterIn = computer.createArrayInput<unsigned int>("randomCounterIn", 2);
+            randomCounterIn.access<unsigned int>(0) = 0;
+            randomCounterIn.access<unsigned int>(1) = randomKey;
+        }
+
+        // every kernel launch uses a new iteration value so that no random number is reused (until 2^32 launches)
+        void advanceRandomCounter()
+        {
+            randomCounterIn.access<unsigned int>(0) = randomCounter++;
+            randomCounterIn.access<unsigned int>(1) = randomKey;
+        }
+
+        // host-side random numbers (initial population, resampling offsets) also follow setRandomSeed, consecutive runs continue with different numbers
+        std::mt19937 hostRandomEngine() const
+        {
+            std::seed_seq seeds{ randomKey, randomCounter };
+            return std::mt19937(seeds);
+        }
+
+        // splits user code into declarations that OpenCL allows only at kernel-function scope (local arrays, with #define lines they may depend on) and the rest
+        // for kernels that evaluate user code inside a loop: first part is written at kernel scope, second part inside the loop
+        // only top-level statements of user code are moved (local declarations in nested blocks are not valid in any kernel)
+        static std::pair<std::string, std::string> splitKernelScopeDeclarations(const std::string& code)
+        {
+            std::string declarations;
+            std::string rest;
+            int depth = 0;
+            bool statementStart = true;
+            bool lineStart = true;
+            size_t i = 0;
+            while (i < code.size())
+            {
+                const char c = code[i];
+                if (code.compare(i, 2, "//") == 0 || code.compare(i, 2, "/*") == 0)
+                {
+                    const bool lineComment = code[i + 1] == '/';
+                    size_t end = code.find(lineComment ? "\n" : "*/", i + 2);
+                    end = (end == std::string::npos) ? code.size() : end + (lineComment ? 0 : 2);
+                    rest += code.substr(i, end - i);
+                    i = end;
+                }
+                else if (c == '"' || c == '\'')
+                {
+                    size_t end = i + 1;
+                    while (end < code.size() && code[end] != c)
+                        end += (code[end] == '\\') ? 2 : 1;
+                    end = std::min(end + 1, code.size());
+                    rest += code.substr(i, end - i);
+                    i = end;
+                    statementStart = false;
+                    lineStart = false;
+                }
+                else if (c == '#' && lineStart)
+                {
+                    // directive continues on next line after a backslash
+                    size_t end = i;
+                    while (end < code.size() && (code[end] != '\n' || code[end - 1] == '\\'))
+                        end++;
+                    const std::string directive = code.substr(i, end - i);
+                    if (directive.compare(0, 7, "#define") == 0)
+                        declarations += directive + "\n";
+                    else
+                        rest += directive;
+                    i = end;
+                }
+                else if (std::isalpha((unsigned char)c) || c == '_')
+                {
+                    size_t end = i;
+                    while (end < code.size() && (std::isalnum((unsigned char)code[end]) || code[end] == '_'))
+                        end++;
+                    const std::string word = code.substr(i, end - i);
+                    if (statementStart && depth == 0 && (word == "local" || word == "__local"))
+                    {
+                        end = code.find(';', end);
+                        end = (end == std::string::npos) ? code.size() : end + 1;
+                        declarations += code.substr(i, end - i) + "\n";
+                    }
+                    else
+                    {
+                        rest += word;
+                        statementStart = false;
+                    }
+                    i = end;
+                    lineStart = false;
+                }
+                else
+                {
+                    if (c == '{' || c == '(' || c == '[')
+                        depth++;
+                    else if (c == '}' || c == ')' || c == ']')
+                        depth--;
+                    if (c == '{' || c == '}' || c == ';')
+                        statementStart = true;
+                    else if (!std::isspace((unsigned char)c))
+                        statementStart = false;
+                    if (c == '\n')
+                        lineStart = true;
+                    else if (!std::isspace((unsigned char)c))
+                        lineStart = false;
+                    rest += c;
+                    i++;
+                }
+            }
+            return std::make_pair(declarations, rest);
+        }
+
+        // random number generation and work-group loop macros that user-code can use
+        std::string helperFunctions() const
+        {
+            return std::string(R"(
+            // Philox4x32-10 counter-based generator: 4 random values per unique counter (c0,c1,c2,c3), without any state
+            // kernels use counter = (object, parameter or stream, iteration, sub-step) and key = (randomKey, 0)
+            typedef struct { unsigned int x; unsigned int y; unsigned int z; unsigned int w; } Philox4x32;
 
-            kernel = constants + std::string(R"(
-   		    const unsigned int rnd(unsigned int seed)
-		    {			
-			    seed = (seed ^ 61) ^ (seed >> 16);
-			    seed *= 9;
-			    seed = seed ^ (seed >> 4);
-			    seed *= 0x27d4eb2d;
-			    seed = seed ^ (seed >> 15);
-			    return seed;
-		    }
+            Philox4x32 philox(unsigned int c0, unsigned int c1, unsigned int c2, unsigned int c3, unsigned int key0, unsigned int key1)
+            {
+                for(int i=0;i<10;i++)
+                {
+                    const unsigned int hi0 = mul_hi(0xD2511F53u, c0);
+                    const unsigned int lo0 = 0xD2511F53u * c0;
+                    const unsigned int hi1 = mul_hi(0xCD9E8D57u, c2);
+                    const unsigned int lo1 = 0xCD9E8D57u * c2;
+                    c0 = hi1 ^ c1 ^ key0;
+                    c1 = lo1;
+                    c2 = hi0 ^ c3 ^ key1;
+                    c3 = lo0;
+                    key0 += 0x9E3779B9u;
+                    key1 += 0xBB67AE85u;
+                }
+                Philox4x32 result;
+                result.x = c0;
+                result.y = c1;
+                result.z = c2;
+                result.w = c3;
+                return result;
+            }
 
             const GPGPU_REAL_VAL random(unsigned int seed)
             {
                 return seed * UIMAXFLOATINV;
             }
 
+            // random value in [1e-6, 1 - 1e-6] (random() can round to 0 or 1), its logarithm is negative and pi * (value - 0.5) is inside (-pi/2, pi/2)
+            const GPGPU_REAL_VAL randomOpen(unsigned int seed)
+            {
+                return clamp(random(seed), (GPGPU_REAL_VAL)0.000001, (GPGPU_REAL_VAL)0.999999);
+            }
+
+            // adds change to value and wraps the result into (0,1) range (large steps are first reduced into (-1,1) without losing precision)
+            const GPGPU_REAL_VAL wrapNormalized(GPGPU_REAL_VAL value, GPGPU_REAL_VAL change)
+            {
+                const GPGPU_REAL_VAL result = value + fmod(change, (GPGPU_REAL_VAL)1.0);
+                return result - floor(result);
+            }
+
+            // a random step with the distribution selected by MutationDistribution, from 2 random values
+            const GPGPU_REAL_VAL mutationStep(unsigned int random1, unsigned int random2)
+            {
+                const GPGPU_REAL_VAL gpgpuHalf = 0.5;
+                const GPGPU_REAL_VAL u1 = randomOpen(random1);
+                const GPGPU_REAL_VAL u2 = randomOpen(random2);
+#if MutationDistribution == 1
+                return gpgpuHalf * sqrt(-2.0f * log(u1)) * cos((GPGPU_REAL_VAL)(2.0f * M_PI_F) * u2);
+#elif MutationDistribution == 2
+                return gpgpuHalf * tan((GPGPU_REAL_VAL)M_PI_F * (u1 - gpgpuHalf));
+#elif MutationDistribution == 3
+                const GPGPU_REAL_VAL v = (GPGPU_REAL_VAL)M_PI_F * (u1 - gpgpuHalf);
+                const GPGPU_REAL_VAL w = -log(u2);
+                return gpgpuHalf * (sin(LevyAlpha * v) / pow(cos(v), 1.0f / LevyAlpha)) * pow(cos(v - LevyAlpha * v) / w, (1.0f - LevyAlpha) / LevyAlpha);
+#else
+                GPGPU_REAL_VAL change = u1 - gpgpuHalf;
+                if(u2 > 0.97f)
+                    change *= 10.0f;
+                if(u2 > 0.99f)
+                    change *= 5.0f;
+                if(u2 > 0.997f)
+                    change *= 5.0f;
+                if(u2 > 0.9992f)
+                    change *= 5.0f;
+                return change;
+#endif
+            }
+
 #define parallelFor(ITERS,BODY)                                 \
 {\
     const int numLoopIter = (ITERS / WorkGroupThreads) + 1;     \
@@ -132,93 +707,142 @@ namespace UFSACL
         }                                                       \
 }
 
+// same as parallelFor but visits only every fidelityStride-th item (starting from fidelityOffset)
+// solver sets the stride (1 = full fidelity) and scales energy, so energy should be only a sum of terms computed in this loop
+#define parallelForFidelity(ITERS,BODY)                                 \
+{\
+    const int numLoopIterFidelity = ((ITERS) / (WorkGroupThreads * fidelityStride)) + 1;     \
+        for(int iGPGPU=0;iGPGPU<numLoopIterFidelity;iGPGPU++)                          \
+        {                                                       \
+            const int loopId = fidelityOffset + fidelityStride * (threadId + WorkGroupThreads * iGPGPU); \
+            if(loopId < ITERS)                                  \
+            {                                                   \
+                BODY                                           \
+            }                                                   \
+        }                                                       \
+}
 
+// same as parallelFor but whole work-group stops after a chunk (WorkGroupThreads items) when partial energy of work-group (sum over its threads) exceeds energyBound
+// energyBound is set by solver (candidate can not be accepted with a higher energy), so energy needs to be a sum of non-negative terms
+// partial sums are reduced in local memory at each chunk boundary and all threads read the same sum, so all of them stop after the same chunk
+#define parallelForWithEarlyExit(ITERS,BODY)                                 \
+{\
+    const int numLoopIter = (ITERS / WorkGroupThreads) + 1;     \
+        for(int iGPGPU=0;iGPGPU<numLoopIter;iGPGPU++)                          \
+        {                                                       \
+            const int loopId = threadId + WorkGroupThreads * iGPGPU; \
+            if(loopId < ITERS)                                  \
+            {                                                   \
+                BODY                                           \
+            }                                                   \
+            GPGPU_REAL_VAL groupEnergyGPGPU;                    \
+            parallelReduce(earlyExitEnergy, energy, groupEnergyGPGPU); \
+            if(groupEnergyGPGPU > energyBound)                  \
+                break;                                          \
+        }                                                       \
+}
 
-            kernel void kernelFunction(global unsigned int * seedIn, global unsigned int * seedOut, global GPGPU_REAL_VAL * tempIn, global GPGPU_REAL_VAL * energyOut, global GPGPU_REAL_VAL * parameterIn, global GPGPU_REAL_VAL * parameterOut )") + userInputs + std::string(R"()
-            {
-                const int id = get_global_id(0);
-                const int groupId = id / WorkGroupThreads;
-                const int localId = id % WorkGroupThreads;
-                local GPGPU_REAL_VAL parameters[NumParameters];
-                local GPGPU_REAL_VAL energies[WorkGroupThreads];
-                const GPGPU_REAL_VAL temperature = tempIn[0];
-                const int numLoopIter = (NumParameters / WorkGroupThreads) + 1;
-                unsigned int tmpRnd = seedIn[id];
-                const GPGPU_REAL_VAL gpgpuHalf = 0.5;
-                for(int i=0;i<numLoopIter;i++)
-                {
-                    const int loopId = localId + WorkGroupThreads * i;
-                    if(loopId < NumParameters)
-                    {
-                        tmpRnd = rnd(tmpRnd);
-                        GPGPU_REAL_VAL randomization = random(tmpRnd);
-                        tmpRnd = rnd(tmpRnd);
-                        GPGPU_REAL_VAL chance = random(tmpRnd)+(GPGPU_REAL_VAL)0.000000001;
-                        tmpRnd = rnd(tmpRnd);
-                        GPGPU_REAL_VAL probability = random(tmpRnd)+(GPGPU_REAL_VAL)0.000000001;
-                        
-                        GPGPU_REAL_VAL change = (randomization - gpgpuHalf)*temperature;
+// same as parallelFor but visits only the items of the shard computed by this work-group (inputs added by addShardedUserInput)
+// loopId indexes the sharded inputs, shardFirstItem + loopId is index of the item in whole dataset (64-bit as whole dataset can exceed int range)
+#define parallelForShard(BODY)                                 \
+{\
+    const long numLoopIterShard = (shardNumItems / WorkGroupThreads) + 1;     \
+        for(long iGPGPU=0;iGPGPU<numLoopIterShard;iGPGPU++)                          \
+        {                                                       \
+            const long loopId = threadId + WorkGroupThreads * iGPGPU; \
+            if(loopId < shardNumItems)                          \
+            {                                                   \
+                BODY                                           \
+            }                                                   \
+        }                                                       \
+}
 
-                        if(chance > 0.97f)
-                            change *= 10.0f;
-                        if(chance > 0.99f)
-                            change *= 5.0f;
-                        if(chance > 0.997f)
-                            change *= 5.0f;
-                        if(chance > 0.9992f)
-                            change *= 5.0f;
+// cooperative work-group helpers over local scratch arrays declared by user code (for example: local float tileX[1024];)
+// scratch arrays need to be declared at top level of user code (OpenCL allows local declarations only at kernel scope)
+// all threads of work-group need to reach them (not inside parallelFor branches) because they use barriers
 
-                        parameters[loopId] = fmod(parameterIn[loopId] + change + 10000.0,1.0);//fmod((double)parameterIn[loopId] + change + 10000.0,1.0);
-                    }
-                }
-                seedOut[id]=tmpRnd;
-                barrier(CLK_LOCAL_MEM_FENCE);
+// copies COUNT elements of SOURCE starting at FIRST into local TILE (coalesced, each element loaded once per work-group)
+// waits for all threads before copying (previous tile can be read until this point) and after copying
+#define tileLoad(TILE,SOURCE,FIRST,COUNT)                      \
+{\
+    barrier(CLK_LOCAL_MEM_FENCE);                               \
+    for(int iTileGPGPU=threadId;iTileGPGPU<(COUNT);iTileGPGPU+=WorkGroupThreads) \
+        TILE[iTileGPGPU] = SOURCE[(FIRST) + iTileGPGPU];        \
+    barrier(CLK_LOCAL_MEM_FENCE);                               \
+}
 
-                // objective function by user                
-                GPGPU_REAL_VAL energy = GPGPU_ZERO_REAL_VAL;
-                const int threadId = localId;
-                const int objectId = groupId;
-                )") + funcMin + std::string(R"(
-                energies[localId] = energy;
-                // objective function end
+// sum of VALUE of all threads is written to RESULT of all threads, SCRATCH = local array of WorkGroupThreads elements
+#define parallelReduce(SCRATCH,VALUE,RESULT)                    \
+{\
+    SCRATCH[threadId] = (VALUE);                                \
+    barrier(CLK_LOCAL_MEM_FENCE);                               \
+    for(int sGPGPU=WorkGroupThreadsPow2/2;sGPGPU>0;sGPGPU>>=1)  \
+    {                                                           \
+        if(threadId < sGPGPU && threadId + sGPGPU < WorkGroupThreads) \
+            SCRATCH[threadId] += SCRATCH[threadId + sGPGPU];    \
+        barrier(CLK_LOCAL_MEM_FENCE);                           \
+    }                                                           \
+    RESULT = SCRATCH[0];                                        \
+    barrier(CLK_LOCAL_MEM_FENCE);                               \
+}
 
-                barrier(CLK_LOCAL_MEM_FENCE);
-                for(unsigned int i=WorkGroupThreads/2;i>=1;i>>=1)
-                {
-                    unsigned int reduceId = i + localId;
-                    if(localId<i)
-                        energies[localId] += energies[reduceId]; 
-                    barrier(CLK_LOCAL_MEM_FENCE);
-                }
-                if(localId == 0)
-                    energyOut[id]=energies[0];
-
-                for(int i=0;i<numLoopIter;i++)
-                {
-                    const int loopId = localId + WorkGroupThreads * i;
-                    const int arrayId = loopId + groupId*WorkGroupThreads*NumParamsPerThread;
-                    if(loopId < NumParameters)
-                    {
-                        parameterOut[arrayId] = parameters[loopId];
-                    }
-                }
-            }
-        )");
-
-            computer.compile(kernel, "kernelFunction");
-            randomDataIn = computer.createArrayInputLoadBalanced<unsigned int>("rndIn", numWorkGroupsToRun * workGroupThreads);
-            randomDataOut = computer.createArrayOutput<unsigned int>("rndOut", numWorkGroupsToRun * workGroupThreads);
-            energyOut = computer.createArrayOutput<ParameterType>("energyOut", numWorkGroupsToRun * workGroupThreads);
+// inclusive prefix sum: RESULT of thread t = sum of VALUE of threads 0..t, SCRATCH = local array of 2 x WorkGroupThreads elements (double-buffered)
+#define parallelScan(SCRATCH,VALUE,RESULT)                      \
+{\
+    int readGPGPU = 0;                                          \
+    SCRATCH[threadId] = (VALUE);                                \
+    barrier(CLK_LOCAL_MEM_FENCE);                               \
+    for(int sGPGPU=1;sGPGPU<WorkGroupThreads;sGPGPU<<=1)        \
+    {                                                           \
+        const int writeGPGPU = WorkGroupThreads - readGPGPU;    \
+        SCRATCH[writeGPGPU + threadId] = (threadId >= sGPGPU) ? (SCRATCH[readGPGPU + threadId] + SCRATCH[readGPGPU + threadId - sGPGPU]) : SCRATCH[readGPGPU + threadId]; \
+        readGPGPU = writeGPGPU;                                 \
+        barrier(CLK_LOCAL_MEM_FENCE);                           \
+    }                                                           \
+    RESULT = SCRATCH[readGPGPU + threadId];                     \
+    barrier(CLK_LOCAL_MEM_FENCE);                               \
+}
 
-            parameterIn = computer.createArrayInput<ParameterType>("parameterIn", NumParameters);
-            temperatureIn = computer.createArrayInput<ParameterType>("tempIn", 1);
-            parameterOut = computer.createArrayOutput<ParameterType>("parameterOut",
-                numWorkGroupsToRun * numParametersItersPerWorkgroupWithUnused * workGroupThreads, numParametersItersPerWorkgroupWithUnused);
+// minimum of VALUE of all threads and its INDEX (lowest index on ties) are written to RESULT_VALUE and RESULT_INDEX of all threads
+// SCRATCH_VALUE and SCRATCH_INDEX = local arrays of WorkGroupThreads elements
+#define parallelMinIndex(SCRATCH_VALUE,SCRATCH_INDEX,VALUE,INDEX,RESULT_VALUE,RESULT_INDEX) \
+{\
+    SCRATCH_VALUE[threadId] = (VALUE);                          \
+    SCRATCH_INDEX[threadId] = (INDEX);                          \
+    barrier(CLK_LOCAL_MEM_FENCE);                               \
+    for(int sGPGPU=WorkGroupThreadsPow2/2;sGPGPU>0;sGPGPU>>=1)  \
+    {                                                           \
+        if(threadId < sGPGPU && threadId + sGPGPU < WorkGroupThreads) \
+        {                                                       \
+            const int otherGPGPU = threadId + sGPGPU;           \
+            if(SCRATCH_VALUE[otherGPGPU] < SCRATCH_VALUE[threadId] || (SCRATCH_VALUE[otherGPGPU] == SCRATCH_VALUE[threadId] && SCRATCH_INDEX[otherGPGPU] < SCRATCH_INDEX[threadId])) \
+            {                                                   \
+                SCRATCH_VALUE[threadId] = SCRATCH_VALUE[otherGPGPU]; \
+                SCRATCH_INDEX[threadId] = SCRATCH_INDEX[otherGPGPU]; \
+            }                                                   \
+        }                                                       \
+        barrier(CLK_LOCAL_MEM_FENCE);                           \
+    }                                                           \
+    RESULT_VALUE = SCRATCH_VALUE[0];                            \
+    RESULT_INDEX = SCRATCH_INDEX[0];                            \
+    barrier(CLK_LOCAL_MEM_FENCE);                               \
+}
 
-            for (int i = 0; i < numWorkGroupsToRun * workGroupThreads; i++)
-                randomDataIn.access<unsigned int>(i) = i;
+)");
         }
 
+        // appends user inputs (in the order they were added) to the kernel arguments
+        GPGPU::HostParameter bindUserInputs(GPGPU::HostParameter kernelParams)
+        {
+            const int sz = userInputFullAccess.size();
+            for (int i = 0; i < sz; i++)
+            {
+                auto kernelParamsNew = kernelParams.next(userInputFullAccess[i]);
+                kernelParams = kernelParamsNew;
+            }
+            return kernelParams;
+        }
+    public:
         // declare a function before simulated-annealing-kernel, to improve code reusability
         // can be called multiple times or once to add all user-functions
         void addFunctionDefinition(std::string userFunctionPrm)
@@ -230,272 +854,2406 @@ namespace UFSACL
 )";
         }
 
-        // use additional buffers from host-environment in simulated-annealing kernel
-        // use same name with this in kernel when accessing data
-        // only simulated-annealing (to be minimized) energy function parameters are cached inside local (in-chip) fast memory
-        // any data added with addUserInput method is directly accessed from video-memory that is likely cached by hardware
-        // if data with same name exists, it updates the data
-        template<typename T>
-        void addUserInput(std::string customInputName, std::vector<T> customInput)
+        // selects distribution of mutation steps, levy alpha is only used by MUTATION_LEVY_STABLE and needs to be in (0,2] range
+        // needs to be called before build()
+        void setMutationDistribution(MutationDistribution distribution, double levyStableAlpha = 1.5)
         {
-            const int sz = userInputFullAccess.size();
-            for (int i = 0; i < sz; i++)
+            if (levyStableAlpha <= 0.0 || levyStableAlpha > 2.0)
+                throw std::invalid_argument("Error: alpha of Levy-stable distribution must be in (0,2] range.");
+            mutationDistribution = distribution;
+            levyAlpha = levyStableAlpha;
+        }
+
+        // key of random number generator, same seed and same call sequence give same results
+        // can be called any time, takes effect with next run()
+        void setRandomSeed(unsigned int seed)
+        {
+            randomKey = seed;
+            randomCounter = 0;
+        }
+
+        // keeps diagnostics of last traceCapacity iterations of run() in memory: temperature, energies, acceptance ratio, time and copied bytes per device
+        // cheap enough to stay enabled without changing timings (unlike console output of debug flags), can be written to a file with saveTraceJson or saveTraceCsv after run()
+        // traceCapacity = 0 disables tracing, trace is cleared by each call
+        void enableTrace(size_t traceCapacity = 4096)
+        {
+            trace.reset(traceCapacity, computer.getNumDevices());
+            traceTransferredBytes = computer.transferredBytes();
+            traceDeviceNanoSeconds.clear();
+            traceDeviceBytes.clear();
+        }
+
+        // traced iterations, oldest first
+        std::vector<TraceEvent> getTrace() const
+        {
+            return trace.snapshot();
+        }
+
+        void saveTraceJson(std::string path)
+        {
+            trace.writeJson(path, computer.deviceNames(false));
+        }
+
+        void saveTraceCsv(std::string path)
+        {
+            trace.writeCsv(path, computer.getNumDevices());
+        }
+
+        // names of selected devices, on the same order as per-device values of trace events
+        std::vector<std::string> getDeviceNames()
+        {
+            return computer.deviceNames(false);
+        }
+
+        // callback of run() is called from a dispatcher thread with a copy of each improved solution, so annealing loop does not wait for it
+        // at most queueCapacity solutions wait for callback, older ones are dropped when callback can not keep up (latest one is always delivered)
+        // run() returns after all queued solutions are delivered, callback must not call other methods of solver while run() is running
+        // queueCapacity = 0: callback is called synchronously inside annealing loop (default)
+        void setAsynchronousCallback(size_t queueCapacity = 1)
+        {
+            callbackQueueCapacity = queueCapacity;
+        }
+
+        // multiplies mutation steps of each parameter with its own scale (1 value per parameter), to tune move sizes per dimension of energy landscape
+        // can be updated after build() only if it was also set before build()
+        void setParameterStepScales(std::vector<double> scales)
+        {
+            if (scales.size() != (size_t)numParameters)
+                throw std::invalid_argument("Error: number of step scales must be equal to number of parameters.");
+            if (parameterStepScales.size() > 0 && stepScaleIn.getName() != "")
             {
-                if (customInputName == userInputFullAccess[i].getName())
+                for (int i = 0; i < numParameters; i++)
                 {
-                    userInputFullAccess[i].copyDataFromPtr(customInput.data());
-                    return;
+                    if (stepScaleIn.getElementSize() == sizeof(float))
+                        stepScaleIn.access<float>(i) = scales[i];
+                    else
+                        stepScaleIn.access<double>(i) = scales[i];
                 }
             }
+            parameterStepScales = scales;
+        }
 
-            // fully-copied array (for all GPGPU devices to have all-element random-access in kernel)
-            userInputFullAccess.emplace_back(computer.createArrayInput<T>(customInputName, customInput.size(), 1));
-            userInputFullAccess[sz].copyDataFromPtr(customInput.data());
-            userInputsWithoutTypes += std::string(", ") + customInputName;
+    protected:
+        // device times of last computation of kernels and bytes copied since previous measurement (needs to be called when no computation is running)
+        void measureDevices(const std::vector<std::string>& kernelNames)
+        {
+            if (!trace.enabled())
+                return;
+            traceDeviceNanoSeconds = computer.lastComputeTimes(kernelNames);
+            const std::vector<size_t> bytes = computer.transferredBytes();
+            traceDeviceBytes.resize(bytes.size());
+            for (size_t i = 0; i < bytes.size(); i++)
+                traceDeviceBytes[i] = bytes[i] - traceTransferredBytes[i];
+            traceTransferredBytes = bytes;
+        }
+
+        // storage of next trace event with last device measurements
+        TraceEvent& nextTraceEvent()
+        {
+            TraceEvent& event = trace.next();
+            for (size_t i = 0; i < traceDeviceNanoSeconds.size() && i < event.deviceNanoSeconds.size(); i++)
+            {
+                event.deviceNanoSeconds[i] = traceDeviceNanoSeconds[i];
+                event.deviceBytes[i] = traceDeviceBytes[i];
+            }
+            return event;
+        }
+
+        // kernel argument declaration for a user input of type T
+        template<typename T>
+        static std::string userInputArgument()
+        {
             if (typeid(T) == typeid(char))
             {
-                userInputs += std::string(", global char * ") + customInputName;
+                return std::string(", global char * ");
             }
             else if (typeid(T) == typeid(unsigned char))
             {
-                userInputs += std::string(", global unsigned char * ") + customInputName;
+                return std::string(", global unsigned char * ");
             }
             else if (typeid(T) == typeid(bool))
             {
-                userInputs += std::string(", global unsigned char * ") + customInputName; // using char instead of bool since opencl not good at that
+                return std::string(", global unsigned char * "); // using char instead of bool since opencl not good at that
             }
             else if (typeid(T) == typeid(short))
             {
-                userInputs += std::string(", global short * ") + customInputName;
+                return std::string(", global short * ");
             }
             else if (typeid(T) == typeid(unsigned short))
             {
-                userInputs += std::string(", global unsigned short * ") + customInputName;
+                return std::string(", global unsigned short * ");
             }
             else if (typeid(T) == typeid(int))
             {
-                userInputs += std::string(", global int * ") + customInputName;
+                return std::string(", global int * ");
             }
             else if (typeid(T) == typeid(unsigned int))
             {
-                userInputs += std::string(", global unsigned int * ") + customInputName;
+                return std::string(", global unsigned int * ");
             }
             else if (typeid(T) == typeid(long long))
             {
-                userInputs += std::string(", global long * ") + customInputName;
+                return std::string(", global long * ");
             }
             else if (typeid(T) == typeid(unsigned long long))
             {
-                userInputs += std::string(", global unsigned long * ") + customInputName;
+                return std::string(", global unsigned long * ");
             }
             else if (typeid(T) == typeid(float))
             {
-                userInputs += std::string(", global float * ") + customInputName;
+                return std::string(", global float * ");
             }
             else if (typeid(T) == typeid(double))
             {
-                userInputs += std::string(", global double * ") + customInputName;
+                return std::string(", global double * ");
             }
             else if (typeid(T) == typeid(std::int8_t))
             {
-                userInputs += std::string(", global char * ") + customInputName;
+                return std::string(", global char * ");
             }
             else if (typeid(T) == typeid(std::int16_t))
             {
-                userInputs += std::string(", global short * ") + customInputName;
+                return std::string(", global short * ");
             }
             else if (typeid(T) == typeid(std::int32_t))
             {
-                userInputs += std::string(", global int * ") + customInputName;
+                return std::string(", global int * ");
             }
             else if (typeid(T) == typeid(std::int64_t))
             {
-                userInputs += std::string(", global long * ") + customInputName;
+                return std::string(", global long * ");
             }
             else if (typeid(T) == typeid(std::uint64_t))
             {
-                userInputs += std::string(", global unsigned long * ") + customInputName;
+                return std::string(", global unsigned long * ");
             }
 
-            return;
+            throw std::invalid_argument("Error: unsupported type of user input.");
         }
 
-
-        std::vector<ParameterType> run(
-            const ParameterType temperatureStart = 1.0f, const ParameterType temperatureStop = 0.01f, const ParameterType temperatureDivider = 2.0f,
-            const int numReheats = 5,
-            const bool debug = false, const bool deviceDebug = false, const bool energyDebug = false,
-            std::function<void(ParameterType*)> callbackLowerEnergyFound = [](ParameterType*) {},
-            std::vector<ParameterType> userHintForInitialParametersNormalized = std::vector<ParameterType>()
-        )
+        // registers a created user input buffer as the last kernel argument
+        void registerUserInput(std::string customInputName, GPGPU::HostParameter buffer, std::string argument)
         {
+            userInputFullAccess.emplace_back(buffer);
+            userInputsWithoutTypes += std::string(", ") + customInputName;
+            userInputs += argument + customInputName;
+        }
 
-            std::random_device rd;
-            std::mt19937 rng{ rd() };
-            std::uniform_real_distribution<float> uid(0.0f, 1.0f);
-
-
-
-            int reheat = numReheats;
-            auto kernelParams = randomDataIn.next(randomDataOut).next(temperatureIn).next(energyOut).next(parameterIn).next(parameterOut);
+        int findUserInput(std::string customInputName)
+        {
             const int sz = userInputFullAccess.size();
             for (int i = 0; i < sz; i++)
             {
-                auto kernelParamsNew = kernelParams.next(userInputFullAccess[i]);
-                kernelParams = kernelParamsNew;
+                if (customInputName == userInputFullAccess[i].getName())
+                    return i;
             }
+            return -1;
+        }
 
-            // initial guess for parameters (middle-points for all dimensions or user hint)
-            if (userHintForInitialParametersNormalized.size() == NumParameters)
+        // new data of an existing user input needs same number of elements (kernels and other inputs may depend on it)
+        void checkUpdatedUserInputSize(int existing, size_t numElements)
+        {
+            if (userInputFullAccess[existing].isSharded())
+                throw std::invalid_argument(std::string("Error: user input ") + userInputFullAccess[existing].getName() + " is sharded, it can only be updated with addShardedUserInput.");
+            if (userInputFullAccess[existing].getNumElements() != numElements)
+                throw std::invalid_argument(std::string("Error: user input ") + userInputFullAccess[existing].getName() + " has " + std::to_string(userInputFullAccess[existing].getNumElements()) + " elements, it can not be updated with " + std::to_string(numElements) + " elements.");
+        }
+    public:
+        // use additional buffers from host-environment in simulated-annealing kernel
+        // use same name with this in kernel when accessing data
+        // only simulated-annealing (to be minimized) energy function parameters are cached inside local (in-chip) fast memory
+        // any data added with addUserInput method is directly accessed from video-memory that is likely cached by hardware
+        // if data with same name exists, it updates the data
+        template<typename T>
+        void addUserInput(std::string customInputName, const std::vector<T>& customInput)
+        {
+            const int existing = findUserInput(customInputName);
+            if (existing >= 0)
             {
-                for (int i = 0; i < NumParameters; i++)
-                {
-                    parameterIn.access<ParameterType>(i) = userHintForInitialParametersNormalized[i];
-                }
+                checkUpdatedUserInputSize(existing, customInput.size());
+
+                // caller's memory of an input from addUserInput(name, shared_ptr, n) is not written, data goes to a new buffer
+                if (userInputFullAccess[existing].isAliasingMemory())
+                    userInputFullAccess[existing] = computer.createArrayInput<T>(customInputName, customInput.size(), 1);
+                userInputFullAccess[existing].copyDataFromPtr(customInput.data());
+                return;
             }
-            else
+
+            // fully-copied array (for all GPGPU devices to have all-element random-access in kernel)
+            GPGPU::HostParameter buffer = computer.createArrayInput<T>(customInputName, customInput.size(), 1);
+            buffer.copyDataFromPtr(customInput.data());
+            registerUserInput(customInputName, buffer, userInputArgument<T>());
+        }
+
+        // same as addUserInput but without any copy on host side: buffer uses the given memory (zero-copy for devices that share RAM) when it is 4096-aligned
+        // memory is kept alive by the solver through the shared pointer (for memory that is owned by someone else, use a no-op deleter and keep it alive during solver's lifetime)
+        // unaligned memory is copied once into an aligned buffer
+        // if data with same name exists, it is switched to the given memory (number of elements can not change), previous memory is not written
+        template<typename T>
+        void addUserInput(std::string customInputName, std::shared_ptr<T> customInput, size_t numElements)
+        {
+            const int existing = findUserInput(customInputName);
+            if (existing >= 0)
             {
-                for (int i = 0; i < NumParameters; i++)
-                {
-                    parameterIn.access<ParameterType>(i) = 0.5f;
-                }
+                checkUpdatedUserInputSize(existing, numElements);
+                userInputFullAccess[existing] = computer.createArrayInputFromMemory<T>(customInputName, numElements, customInput);
+                return;
             }
 
-            ParameterType temp = temperatureStart;
-            ParameterType foundEnergy = std::numeric_limits<ParameterType>::max();
+            registerUserInput(customInputName, computer.createArrayInputFromMemory<T>(customInputName, numElements, customInput), userInputArgument<T>());
+        }
 
-            // compute user-hinted parameters first
-            if (userHintForInitialParametersNormalized.size() == NumParameters)
+        // same as addUserInput but data is a memory-mapped binary file of T values (number of elements = file size / sizeof(T))
+        // nothing is read at startup, pages are loaded on first access and page-cache of file is shared between processes
+        // if data with same name exists, it is switched to the new file (number of elements can not change)
+        template<typename T>
+        void addUserInputFromFile(std::string customInputName, std::string path)
+        {
+            const int existing = findUserInput(customInputName);
+            if (existing >= 0)
             {
-                // to compute with hint parameters exactly, set temperature to zero
-                temperatureIn.access<ParameterType>(0) = 0;
-                // run all GPUs to iterate random seeds
-                computer.compute(kernelParams, "kernelFunction", 0, numWorkGroupsToRun * workGroupThreads, workGroupThreads);
-                randomDataIn.copyDataFromPtr(randomDataOut.accessPtr<unsigned int>(0));
-                // get energy of hint
-                foundEnergy = energyOut.access<ParameterType>(0);
+                size_t numBytes = 0;
+                std::shared_ptr<int8_t> bytes = GPGPU::mapFile(path, numBytes);
+                checkUpdatedUserInputSize(existing, numBytes / sizeof(T));
+                userInputFullAccess[existing] = computer.createArrayInputFromMemory<T>(customInputName, numBytes / sizeof(T), std::shared_ptr<T>(bytes, reinterpret_cast<T*>(bytes.get())));
+                return;
             }
 
+            registerUserInput(customInputName, computer.createArrayInputFromFile<T>(customInputName, path), userInputArgument<T>());
+        }
 
-            // initialize temperature
-            temperatureIn.access<ParameterType>(0) = temperatureStart;
 
+    };
 
-            int foundId = -1;
-            int iter = 0;
-            int foundIdBest = -1;
+    // abstract solver that takes user algorithm into OpenCL kernel and runs on thousands of (GPU/CPU) threads
+    // kernel indexing switches to 64-bit automatically when (num parameters X num objects) or buffer sizes exceed 2 billion elements
+    // NumObjects = number of clones of state-machine (that are computed in parallel)
+    // NumParameters = number of parameters to tune to minimize energy
+    // ParameterType = float or double
+    template<int NumParameters, int NumObjects, typename ParameterType = float>
+    struct UltraFastSimulatedAnnealing : public SolverBase
+    {
+    private:
+        GPGPU::HostParameter energyOut;
+        GPGPU::HostParameter probeEnergyOut;
+        GPGPU::HostParameter parameterIn;
+        GPGPU::HostParameter parameterOut;
+        GPGPU::HostParameter temperatureIn;
+        GPGPU::HostParameter mutationFactorIn;
+        ParameterType currentEnergy;
+        std::vector<ParameterType> currentParameters;
+        std::vector<ParameterType> bestParameters;
+        int correlatedMutationRank;
+        ParameterType correlatedMutationRatio;
+        int mutationFactorRow;
+        CoolingSchedule coolingSchedule;
+        double targetAcceptanceRatio;
+        bool perObjectStepScaling;
+        GPGPU::HostParameter objectStepScaleIn;
+        std::vector<int> acceptanceCounts;
+        int fidelityMaxStride;
+        int polishRounds;
+        int polishCandidates;
+        GPGPU::HostParameter polishSettingsIn;
+        GPGPU::HostParameter polishCenterIn;
+        GPGPU::HostParameter hintIn;
+        bool hintKernelCompiled;
+        int numShards;
+        size_t numShardedItems;
+        size_t shardItems;
+        size_t leastSquaresPoints;
+        ParameterType leastSquaresMin;
+        ParameterType leastSquaresMax;
+        int candidatesPerGroup;
+        std::vector<std::string> energyStages;
+        GPGPU::HostParameter stageCandidates;
+        int candidatesPerThread;
+        size_t vectorLocalThreads;
+        // elements per object in energyOut (energy, acceptance flag, unused) and parameterOut (parameters, unused)
+        // compact in thread-per-candidate mode, padded to work-group threads otherwise
+        size_t objectEnergyStride;
+        size_t objectParameterStride;
 
-            std::vector<double> perf;
-            size_t measuredNanoSecTot = 0;
-            ParameterType bestEnergy = foundEnergy;
-            {
-                GPGPU::Bench benchTot(&measuredNanoSecTot);
-                while (temp > temperatureStop)
-                {
-                    if (debug)
-                        std::cout << "iteration-" << iter++ << std::endl;
-                    bool foundBetterEnergy = false;
-                    bool foundBestEnergy = false;
-                    size_t measuredNanoSec = 0;
-                    bool doNotHeat = false;
-                    {
-                        GPGPU::Bench bench(&measuredNanoSec);
-                        perf = computer.compute(kernelParams, "kernelFunction", 0, numWorkGroupsToRun * workGroupThreads, workGroupThreads);
-                        randomDataIn.copyDataFromPtr(randomDataOut.accessPtr<unsigned int>(0));
+        // convergence curve of last run()
+        bool convergenceTracing;
+        ConvergenceTrace convergence;
+        std::vector<ParameterType> populationEnergies;
 
-                        ParameterType tmpEn = std::numeric_limits<double>::max();
-                        int tmpI = -1;
+        // annealing state of run() loop that is not kept in buffers (mirrored after each iteration for checkpoints)
+        ParameterType runTemperature;
+        int runReheatsLeft;
+        ParameterType runCurrentEnergy;
+        ParameterType runBestEnergy;
+        bool resumePending;
+        std::future<void> checkpointWriter;
+        std::string autoCheckpointPath;
+        int autoCheckpointInterval;
+        int iterationsSinceCheckpoint;
 
-                        for (int i = 0; i < NumObjects; i++)
-                        {
-                            const int index = i * workGroupThreads;
+        // run() returns early when best energy reaches stopEnergy or after maxSeconds
+        ParameterType stopEnergy;
+        double maxRunSeconds;
 
-                            const ParameterType energy = energyOut.access<ParameterType>(index);
-                            if (tmpEn > energy)
-                            {
-                                tmpEn = energy;
-                                tmpI = i;
-                            }
-                        }
+        void recordRunState(ParameterType temperature, int reheatsLeft, ParameterType currentEnergy, ParameterType bestEnergy)
+        {
+            runTemperature = temperature;
+            runReheatsLeft = reheatsLeft;
+            runCurrentEnergy = currentEnergy;
+            runBestEnergy = bestEnergy;
+            if (autoCheckpointInterval > 0 && ++iterationsSinceCheckpoint >= autoCheckpointInterval)
+            {
+                iterationsSinceCheckpoint = 0;
+                saveCheckpoint(autoCheckpointPath);
+            }
+        }
 
-                        if (foundEnergy > tmpEn && tmpI >= 0)
-                        {
-                            foundEnergy = tmpEn;
-                            foundId = tmpI;
-                            foundBetterEnergy = true;
-                            if (bestEnergy > tmpEn)
-                            {
-                                bestEnergy = tmpEn;
-                                foundIdBest = tmpI;
-                                foundBestEnergy = true;
-                            }
-                        }
-                        else if (false && tmpI >= 0)
-                        {
-                            doNotHeat = true;
-                            double rnd0 = uid(rng);
-                            double dE = std::abs(foundEnergy - tmpEn) / std::abs(std::numeric_limits<double>::min() + foundEnergy);
+        template<typename T>
+        static void appendCheckpoint(std::vector<char>& data, const T& value)
+        {
+            const char* ptr = reinterpret_cast<const char*>(&value);
+            data.insert(data.end(), ptr, ptr + sizeof(T));
+        }
 
-                            if (rnd0 < std::exp(-dE / (temp * 0.1)))
-                            {
-                                foundEnergy = tmpEn;
-                                foundId = tmpI;
-                                foundBetterEnergy = true;
-                            }
-                        }
-                    }
-                    if (debug)
-                        std::cout << "computation-time=" << measuredNanoSec * 0.000000001 << " seconds" << std::endl;
-                    if (foundBetterEnergy)
-                    {
-                        if (!doNotHeat)
-                            temp *= std::pow(temperatureDivider, 2.0); // as long as better states are found, temperature can be kept high
+        template<typename T>
+        static T readCheckpoint(std::ifstream& file)
+        {
+            T value;
+            if (!file.read(reinterpret_cast<char*>(&value), sizeof(T)))
+                throw std::invalid_argument("Error: checkpoint file is truncated.");
+            return value;
+        }
 
+        // scores M hint vectors (NumObjects per launch, 1 per work-group) and writes the lowest-energy one into parameterIn
+        // evaluation kernel is compiled on first use only
+        ParameterType scoreHints(const std::vector<ParameterType>& hints)
+        {
+            if (!hintKernelCompiled)
+            {
+                const std::string hintKernel = kernel + std::string(R"(
+            kernel void hintKernel(global GPGPU_REAL_VAL * hintIn, global GPGPU_REAL_VAL * energyOut )") + userInputs + std::string(R"()
+            {
+                const GPGPU_INDEX id = get_global_id(0);
+                const int groupId = id / WorkGroupThreads;
+                const int localId = id % WorkGroupThreads;
+                local GPGPU_REAL_VAL parameters[NumParameters];
+                local GPGPU_REAL_VAL energies[WorkGroupThreads];
+                local GPGPU_REAL_VAL earlyExitEnergy[WorkGroupThreads];
+                const int numLoopIter = (NumParameters / WorkGroupThreads) + 1;
+                for(int i=0;i<numLoopIter;i++)
+                {
+                    const int loopId = localId + WorkGroupThreads * i;
+                    if(loopId < NumParameters)
+                    {
+                        parameters[loopId] = hintIn[loopId + (GPGPU_INDEX)groupId * NumParameters];
+                    }
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
 
-                        for (int i = 0; i < NumParameters; i++)
-                        {
-                            currentParameters[i] = parameterOut.access<ParameterType>(i + foundId * numParametersItersPerWorkgroupWithUnused * workGroupThreads);
-                        }
+                const int fidelityStride = 1;
+                const int fidelityOffset = 0;
+                const GPGPU_REAL_VAL energyBound = (GPGPU_REAL_VAL)INFINITY;
 
-                        if (foundBestEnergy)
-                        {
-                            for (int i = 0; i < NumParameters; i++)
-                            {
-                                bestParameters[i] = parameterOut.access<ParameterType>(i + foundIdBest * numParametersItersPerWorkgroupWithUnused * workGroupThreads);
-                            }
-                        }
+                // objective function by user
+                GPGPU_REAL_VAL energy = GPGPU_ZERO_REAL_VAL;
+                const int threadId = localId;
+                const int objectId = groupId;
+                )") + funcMin + std::string(R"(
+                energies[localId] = energy;
+                // objective function end
 
-                        // new low-energy point becomes new guess for next iteration
+                barrier(CLK_LOCAL_MEM_FENCE);
+                for(unsigned int i=WorkGroupThreads/2;i>=1;i>>=1)
+                {
+                    unsigned int reduceId = i + localId;
+                    if(localId<i)
+                        energies[localId] += energies[reduceId]; 
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+                if(localId == 0)
+                    energyOut[id]=energies[0];
+            }
+        )");
+                computer.compile(hintKernel, "hintKernel");
+                hintIn = computer.createArrayInput<ParameterType>("hintIn", (size_t)NumObjects * NumParameters);
+                hintKernelCompiled = true;
+            }
+
+            const int numHints = hints.size() / NumParameters;
+            auto kernelParams = bindUserInputs(hintIn.next(probeEnergyOut));
+            ParameterType bestHintEnergy = std::numeric_limits<ParameterType>::max();
+            int bestHint = 0;
+            for (int firstHint = 0; firstHint < numHints; firstHint += NumObjects)
+            {
+                // unused work-groups of last launch compute last hint again
+                for (int i = 0; i < NumObjects; i++)
+                    for (int j = 0; j < NumParameters; j++)
+                        hintIn.access<ParameterType>(j + (size_t)i * NumParameters) = hints[j + (size_t)std::min(firstHint + i, numHints - 1) * NumParameters];
+                computer.compute(kernelParams, "hintKernel", 0, numWorkGroupsToRun * workGroupThreads, workGroupThreads);
+                for (int i = 0; i < NumObjects && firstHint + i < numHints; i++)
+                {
+                    const ParameterType energy = probeEnergyOut.access<ParameterType>(i * workGroupThreads);
+                    if (bestHintEnergy > energy)
+                    {
+                        bestHintEnergy = energy;
+                        bestHint = firstHint + i;
+                    }
+                }
+            }
+
+            for (int j = 0; j < NumParameters; j++)
+                parameterIn.access<ParameterType>(j) = hints[j + bestHint * NumParameters];
+            return bestHintEnergy;
+        }
+
+        // program of thread-per-candidate kernel: same mutation as main kernel (same random streams per object), energy code is computed on vectors of candidates
+        std::string vectorKernel(const std::string& mainArguments)
+        {
+            const std::string lanes = std::to_string(candidatesPerThread);
+            const bool scalar = (candidatesPerThread == 1);
+            return constants + helperFunctions() + std::string(R"(
+            #undef CandidateReal
+            #define CandidatesPerThread )") + lanes + std::string(R"(
+            #define CandidateReal )") + (scalar ? std::string("GPGPU_REAL_VAL") : std::string(sizeof(ParameterType) == 8 ? "double" : "float") + lanes) + std::string(R"(
+            #define CandidateLoad(PTR) )") + (scalar ? std::string("(*(PTR))") : std::string("vload") + lanes + "(0, PTR)") + std::string(R"(
+            #define CandidateStore(VALUE,PTR) )") + (scalar ? std::string("(*(PTR) = (VALUE))") : std::string("vstore") + lanes + "(VALUE, 0, PTR)") + std::string(R"(
+            #define CandidatesRejected(VALUE) )") + (scalar ? std::string("((VALUE) > energyBound)") : std::string("all((VALUE) > energyBound)")) + std::string(R"(
+
+            // single work-item loops (work-item is the whole "work-group" of its candidates)
+            #undef parallelFor
+            #undef parallelForWithBarrier
+            #undef parallelForFidelity
+            #undef parallelForWithEarlyExit
+            #undef parallelForShard
+            #undef tileLoad
+            #undef parallelReduce
+            #undef parallelScan
+            #undef parallelMinIndex
+            #define parallelFor(ITERS,BODY) { for(int loopId=0;loopId<(ITERS);loopId++) { BODY } }
+            #define parallelForWithBarrier(ITERS,BODY) parallelFor(ITERS,BODY)
+            #define parallelForFidelity(ITERS,BODY) parallelFor(ITERS,BODY)
+            // stops when all candidates of work-item exceed energyBound (checked every 64 items)
+            #define parallelForWithEarlyExit(ITERS,BODY) { for(int loopId=0;loopId<(ITERS);loopId++) { BODY if((loopId & 63) == 63 && CandidatesRejected(energy)) break; } }
+
+            kernel void kernelFunctionVector()") + mainArguments + std::string(R"()
+            {
+                const GPGPU_INDEX id = get_global_id(0);
+                const int firstObject = id * CandidatesPerThread;
+                const unsigned int iteration = randomCounterIn[0];
+                const unsigned int randomKey = randomCounterIn[1];
+
+                // mutation of each candidate (lane) is same as main kernel: candidateParameters[j * CandidatesPerThread + lane]
+                GPGPU_REAL_VAL candidateParameters[NumParameters * CandidatesPerThread];
+#if CorrelatedMutationRank > 0
+                GPGPU_REAL_VAL correlatedWeights[CorrelatedMutationRank];
+#endif
+                for(int lane=0;lane<CandidatesPerThread;lane++)
+                {
+                    const int object = firstObject + lane;
+#if UseObjectStepScales
+                    const GPGPU_REAL_VAL temperature = tempIn[0] * objectStepScaleIn[object];
+#else
+                    const GPGPU_REAL_VAL temperature = tempIn[0];
+#endif
+#if CorrelatedMutationRank > 0
+                    for(int k=0;k<CorrelatedMutationRank;k++)
+                    {
+                        const Philox4x32 randomValues = philox(object, NumParameters + k, iteration, 0, randomKey, 0);
+                        const GPGPU_REAL_VAL u1 = randomOpen(randomValues.x);
+                        const GPGPU_REAL_VAL u2 = random(randomValues.y);
+                        correlatedWeights[k] = sqrt(-2.0f * log(u1)) * cos((GPGPU_REAL_VAL)(2.0f * M_PI_F) * u2);
+                    }
+#endif
+                    for(int j=0;j<NumParameters;j++)
+                    {
+                        const Philox4x32 randomValues = philox(object, j, iteration, 0, randomKey, 0);
+                        GPGPU_REAL_VAL change = mutationStep(randomValues.x, randomValues.y)*temperature;
+#if CorrelatedMutationRank > 0
+                        GPGPU_REAL_VAL correlatedChange = GPGPU_ZERO_REAL_VAL;
+                        for(int k=0;k<CorrelatedMutationRank;k++)
+                            correlatedChange += correlatedWeights[k] * mutationFactorIn[j + k * NumParameters];
+                        change = change * (1.0f - CorrelatedMutationRatio) + correlatedChange * temperature * CorrelatedMutationRatio;
+#endif
+#if UseParameterStepScales
+                        change *= stepScaleIn[j];
+#endif
+                        candidateParameters[j * CandidatesPerThread + lane] = wrapNormalized(parameterIn[j], change);
+                    }
+                }
+                CandidateReal parameters[NumParameters];
+                for(int j=0;j<NumParameters;j++)
+                    parameters[j] = CandidateLoad(candidateParameters + j * CandidatesPerThread);
+
+                const int fidelityStride = 1;
+                const int fidelityOffset = 0;
+                const GPGPU_REAL_VAL energyBound = tempIn[1];
+                GPGPU_REAL_VAL laneValues[CandidatesPerThread];
+                for(int lane=0;lane<CandidatesPerThread;lane++)
+                    laneValues[lane] = GPGPU_ZERO_REAL_VAL;
+
+                // objective function by user
+                CandidateReal energy = CandidateLoad(laneValues);
+                const int threadId = 0;
+                const int objectId = firstObject;
+                )") + funcMin + std::string(R"(
+                // objective function end
+
+                // compact output: energy and acceptance flag of object at 2 * object, its parameters at object * NumParameters
+                CandidateStore(energy, laneValues);
+                for(int lane=0;lane<CandidatesPerThread;lane++)
+                {
+                    const GPGPU_INDEX object = firstObject + lane;
+                    energyOut[object * 2] = laneValues[lane];
+#if CountAcceptance
+                    energyOut[object * 2 + 1] = (laneValues[lane] < tempIn[1]) ? (GPGPU_REAL_VAL)1.0 : GPGPU_ZERO_REAL_VAL;
+#endif
+                    for(int j=0;j<NumParameters;j++)
+                        parameterOut[j + object * NumParameters] = candidateParameters[j * CandidatesPerThread + lane];
+                }
+            }
+        )");
+        }
+
+        // kernel that computes energies of objects in each iteration
+        // kernels of one computeObjects() step
+        std::vector<std::string> objectsKernelNames() const
+        {
+            if (candidatesPerThread > 0)
+                return { "kernelFunctionVector" };
+            std::vector<std::string> names = { "kernelFunction" };
+            for (size_t i = 0; i < energyStages.size(); i++)
+                names.push_back(std::string("energyStage") + std::to_string(i));
+            return names;
+        }
+
+        // runs main kernel for all objects (on all shards of sharded inputs, each device computing its own shard)
+        // energy stages run after main kernel in same multi-kernel step (each device runs all kernels on same objects)
+        std::vector<double> computeObjects(GPGPU::HostParameter kernelParams)
+        {
+            const int numGroups = numWorkGroupsToRun / candidatesPerGroup;
+            if (candidatesPerThread > 0)
+                return computer.compute(kernelParams, "kernelFunctionVector", 0, NumObjects / candidatesPerThread, vectorLocalThreads);
+            if (energyStages.size() > 0)
+            {
+                std::vector<GPGPU::HostParameter> stageParams = { kernelParams };
+                for (size_t i = 0; i < energyStages.size(); i++)
+                    stageParams.push_back(bindUserInputs(temperatureIn.next(stageCandidates).next(energyOut)));
+                return computer.computeMultiple(stageParams, objectsKernelNames(), 0, numGroups * workGroupThreads, workGroupThreads);
+            }
+            if (numShardedItems > 0)
+                return computer.computeSharded(kernelParams, "kernelFunction", numShards * numGroups * workGroupThreads, workGroupThreads);
+            return computer.compute(kernelParams, "kernelFunction", 0, numGroups * workGroupThreads, workGroupThreads);
+        }
+
+        // energy of an object after computeObjects() = sum of its partial energies on all shards
+        ParameterType objectEnergy(int object)
+        {
+            ParameterType energy = 0;
+            for (int s = 0; s < numShards; s++)
+                energy += energyOut.access<ParameterType>((object + (size_t)s * NumObjects) * objectEnergyStride);
+            return energy;
+        }
+
+        // energy, acceptance flag and parameters of an object in last finished launch
+        ParameterType resultEnergy(int object)
+        {
+            return objectEnergy(object);
+        }
+
+        bool resultAccepted(int object)
+        {
+            return energyOut.access<ParameterType>((size_t)object * objectEnergyStride + 1) > 0.5;
+        }
+
+        ParameterType resultParameter(int object, int parameter)
+        {
+            return parameterOut.access<ParameterType>(parameter + (size_t)object * objectParameterStride);
+        }
+
+        // sets temperature (per-iteration) part of kernel settings
+        void setLaunchSettings(ParameterType temperature, ParameterType currentEnergy, int fidelityStride, bool fidelityRescore)
+        {
+            temperatureIn.access<ParameterType>(0) = temperature;
+            temperatureIn.access<ParameterType>(1) = currentEnergy;
+            temperatureIn.access<ParameterType>(2) = fidelityStride;
+            temperatureIn.access<ParameterType>(3) = fidelityRescore ? 1 : 0;
+        }
+
+        // stride of subsampled energy goes geometrically from fidelityMaxStride at temperatureStart to 1 at temperatureStop
+        int fidelityStrideOf(double temperature, double temperatureStart, double temperatureStop)
+        {
+            if (fidelityMaxStride <= 1 || !(temperature > temperatureStop))
+                return 1;
+            const double ratio = std::min(1.0, std::log(temperature / temperatureStop) / std::log(temperatureStart / temperatureStop));
+            return std::max(1, (int)std::lround(std::pow((double)fidelityMaxStride, ratio)));
+        }
+
+        // stores latest accepted move (normalized by the temperature it was found at) as a row of the low-rank factor of mutation covariance
+        // oldest row is overwritten so that the factor follows the local shape of energy landscape
+        void recordAcceptedMove(ParameterType launchTemperature)
+        {
+            const ParameterType scale = 1.0 / (launchTemperature * std::sqrt((ParameterType)correlatedMutationRank));
+            for (int i = 0; i < NumParameters; i++)
+            {
+                // shortest path on the wrapped (0,1) range
+                ParameterType delta = currentParameters[i] - parameterIn.access<ParameterType>(i);
+                if (delta > 0.5)
+                    delta -= 1.0;
+                if (delta < -0.5)
+                    delta += 1.0;
+                mutationFactorIn.access<ParameterType>(i + mutationFactorRow * NumParameters) = delta * scale;
+            }
+            mutationFactorRow = (mutationFactorRow + 1) % correlatedMutationRank;
+        }
+    public:
+        UltraFastSimulatedAnnealing(std::string funcToMinimize, int gpuThreadsPerObject = 256, int numGPUsToUse = 16, int deviceSelection = GPGPU::Computer::DEVICE_ALL) :SolverBase(funcToMinimize, NumParameters, NumObjects, gpuThreadsPerObject, numGPUsToUse, deviceSelection)
+        {
+            currentParameters.resize(NumParameters);
+            bestParameters.resize(NumParameters);
+            correlatedMutationRank = 0;
+            correlatedMutationRatio = 0;
+            mutationFactorRow = 0;
+            coolingSchedule = COOLING_REHEAT_ON_IMPROVEMENT;
+            targetAcceptanceRatio = 0.2;
+            perObjectStepScaling = false;
+            acceptanceCounts.resize(NumObjects);
+            fidelityMaxStride = 1;
+            polishRounds = 0;
+            polishCandidates = 1;
+            hintKernelCompiled = false;
+            numShards = 1;
+            numShardedItems = 0;
+            shardItems = 0;
+            leastSquaresPoints = 0;
+            leastSquaresMin = 0;
+            leastSquaresMax = 1;
+            candidatesPerGroup = 1;
+            candidatesPerThread = 0;
+            vectorLocalThreads = 1;
+            objectEnergyStride = 0;
+            objectParameterStride = 0;
+            convergenceTracing = false;
+            runTemperature = 0;
+            runReheatsLeft = 0;
+            runCurrentEnergy = std::numeric_limits<ParameterType>::max();
+            runBestEnergy = std::numeric_limits<ParameterType>::max();
+            resumePending = false;
+            autoCheckpointInterval = 0;
+            iterationsSinceCheckpoint = 0;
+            stopEnergy = -std::numeric_limits<ParameterType>::infinity();
+            maxRunSeconds = std::numeric_limits<double>::infinity();
+        }
+
+        // writes a snapshot of solver state (temperature, reheats left, current and best states, random number generator, adaptive mutation and step scale state, load-balancing state)
+        // snapshot is taken immediately, file is written asynchronously (previous write is waited first)
+        // can be called after build(), also from callback of run()
+        void saveCheckpoint(std::string path)
+        {
+            std::vector<char> data;
+            const char magic[8] = { 'U','F','S','A','C','L','C','K' };
+            data.insert(data.end(), magic, magic + 8);
+            appendCheckpoint(data, (int)1);
+            appendCheckpoint(data, (int)NumParameters);
+            appendCheckpoint(data, (int)NumObjects);
+            appendCheckpoint(data, (int)sizeof(ParameterType));
+            appendCheckpoint(data, runTemperature);
+            appendCheckpoint(data, runCurrentEnergy);
+            appendCheckpoint(data, runBestEnergy);
+            appendCheckpoint(data, runReheatsLeft);
+            appendCheckpoint(data, randomKey);
+            appendCheckpoint(data, randomCounter);
+            for (int i = 0; i < NumParameters; i++)
+                appendCheckpoint(data, parameterIn.access<ParameterType>(i));
+            for (int i = 0; i < NumParameters; i++)
+                appendCheckpoint(data, bestParameters[i]);
+            appendCheckpoint(data, correlatedMutationRank);
+            appendCheckpoint(data, mutationFactorRow);
+            for (int i = 0; i < correlatedMutationRank * NumParameters; i++)
+                appendCheckpoint(data, mutationFactorIn.access<ParameterType>(i));
+            appendCheckpoint(data, (int)perObjectStepScaling);
+            for (int i = 0; i < NumObjects; i++)
+                appendCheckpoint(data, perObjectStepScaling ? objectStepScaleIn.access<ParameterType>(i) : (ParameterType)1);
+            for (int i = 0; i < NumObjects; i++)
+                appendCheckpoint(data, acceptanceCounts[i]);
+            const auto loadBalanceState = computer.getLoadBalanceState();
+            appendCheckpoint(data, (int)loadBalanceState.size());
+            for (auto& kernelState : loadBalanceState)
+            {
+                appendCheckpoint(data, (int)kernelState.first.size());
+                data.insert(data.end(), kernelState.first.begin(), kernelState.first.end());
+                appendCheckpoint(data, (int)kernelState.second.size());
+                for (auto& row : kernelState.second)
+                {
+                    appendCheckpoint(data, (int)row.size());
+                    for (auto& value : row)
+                        appendCheckpoint(data, value);
+                }
+            }
+
+            if (checkpointWriter.valid())
+                checkpointWriter.get();
+
+            // written to a temporary file first so that a crash during write does not destroy the previous checkpoint
+            checkpointWriter = std::async(std::launch::async, [data, path]() {
+                const std::string tmpPath = path + ".tmp";
+                {
+                    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                    if (!file.write(data.data(), data.size()))
+                        throw std::invalid_argument(std::string("Error: could not write checkpoint file ") + tmpPath);
+                }
+                std::remove(path.c_str());
+                if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+                    throw std::invalid_argument(std::string("Error: could not rename checkpoint file to ") + path);
+            });
+        }
+
+        // waits for last checkpoint write to complete (rethrows its error)
+        void waitCheckpoint()
+        {
+            if (checkpointWriter.valid())
+                checkpointWriter.get();
+        }
+
+        // loads a checkpoint written by saveCheckpoint() for a solver of same NumParameters, NumObjects, ParameterType and same build() options
+        // next run() continues from checkpoint's temperature, reheats left, current and best states (ignoring hints)
+        // needs to be called after build()
+        void loadCheckpoint(std::string path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+                throw std::invalid_argument(std::string("Error: could not open checkpoint file ") + path);
+            char magic[8];
+            if (!file.read(magic, 8) || std::string(magic, 8) != "UFSACLCK")
+                throw std::invalid_argument("Error: not a checkpoint file.");
+            if (readCheckpoint<int>(file) != 1)
+                throw std::invalid_argument("Error: unsupported checkpoint version.");
+            if (readCheckpoint<int>(file) != NumParameters || readCheckpoint<int>(file) != NumObjects || readCheckpoint<int>(file) != sizeof(ParameterType))
+                throw std::invalid_argument("Error: checkpoint was saved by a solver with different NumParameters, NumObjects or ParameterType.");
+            runTemperature = readCheckpoint<ParameterType>(file);
+            runCurrentEnergy = readCheckpoint<ParameterType>(file);
+            runBestEnergy = readCheckpoint<ParameterType>(file);
+            runReheatsLeft = readCheckpoint<int>(file);
+            randomKey = readCheckpoint<unsigned int>(file);
+            randomCounter = readCheckpoint<unsigned int>(file);
+            for (int i = 0; i < NumParameters; i++)
+                currentParameters[i] = readCheckpoint<ParameterType>(file);
+            for (int i = 0; i < NumParameters; i++)
+                bestParameters[i] = readCheckpoint<ParameterType>(file);
+            if (readCheckpoint<int>(file) != correlatedMutationRank)
+                throw std::invalid_argument("Error: checkpoint was saved with a different rank of correlated mutation.");
+            mutationFactorRow = readCheckpoint<int>(file);
+            for (int i = 0; i < correlatedMutationRank * NumParameters; i++)
+                mutationFactorIn.access<ParameterType>(i) = readCheckpoint<ParameterType>(file);
+            const bool savedObjectStepScales = readCheckpoint<int>(file);
+            for (int i = 0; i < NumObjects; i++)
+            {
+                const ParameterType scale = readCheckpoint<ParameterType>(file);
+                if (savedObjectStepScales && perObjectStepScaling)
+                    objectStepScaleIn.access<ParameterType>(i) = scale;
+                else if (perObjectStepScaling)
+                    objectStepScaleIn.access<ParameterType>(i) = 1;
+            }
+            for (int i = 0; i < NumObjects; i++)
+                acceptanceCounts[i] = readCheckpoint<int>(file);
+            std::map<std::string, std::vector<std::vector<double>>> loadBalanceState;
+            const int numKernels = readCheckpoint<int>(file);
+            for (int k = 0; k < numKernels; k++)
+            {
+                std::string name(readCheckpoint<int>(file), ' ');
+                if (!file.read(&name[0], name.size()))
+                    throw std::invalid_argument("Error: checkpoint file is truncated.");
+                std::vector<std::vector<double>> rows(readCheckpoint<int>(file));
+                for (auto& row : rows)
+                {
+                    row.resize(readCheckpoint<int>(file));
+                    for (auto& value : row)
+                        value = readCheckpoint<double>(file);
+                }
+                loadBalanceState[name] = rows;
+            }
+            computer.setLoadBalanceState(loadBalanceState);
+            resumePending = true;
+        }
+
+        // saves a checkpoint to path after every numIterations iterations of run(), 0 = disabled
+        void setAutoCheckpoint(std::string path, int numIterations)
+        {
+            autoCheckpointPath = path;
+            autoCheckpointInterval = numIterations;
+            iterationsSinceCheckpoint = 0;
+        }
+
+        // run() returns after the iteration that reaches an energy less than or equal to stopEnergyPrm, or after the iteration that exceeds maxSeconds of run time
+        // limits are checked once per iteration, defaults (no limits) are -infinity and infinity
+        void setRunLimits(ParameterType stopEnergyPrm, double maxSeconds = std::numeric_limits<double>::infinity())
+        {
+            if (!(maxSeconds > 0))
+                throw std::invalid_argument("Error: run time limit needs to be greater than zero.");
+            stopEnergy = stopEnergyPrm;
+            maxRunSeconds = maxSeconds;
+        }
+
+        // pattern search around current state and (numCandidates - 1) lowest-energy objects of last iteration
+        // each round evaluates +step and -step along every parameter of every candidate (1 probe per work-group), moves each candidate to its best improving probe or halves its step
+        // returns lowest energy found and its parameters
+        ParameterType refineCandidates(ParameterType initialStep, std::vector<ParameterType>& result)
+        {
+            const int numProbes = 2 * NumParameters + 1;
+
+            std::vector<int> order(NumObjects);
+            for (int i = 0; i < NumObjects; i++)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&](int a, int b) { return resultEnergy(a) < resultEnergy(b); });
+            for (int j = 0; j < NumParameters; j++)
+                polishCenterIn.access<ParameterType>(j) = parameterIn.access<ParameterType>(j);
+            for (int c = 1; c < polishCandidates; c++)
+                for (int j = 0; j < NumParameters; j++)
+                    polishCenterIn.access<ParameterType>(j + c * NumParameters) = resultParameter(order[c - 1], j);
+            for (int c = 0; c < polishCandidates; c++)
+                polishSettingsIn.access<ParameterType>(1 + c) = initialStep;
+
+            auto kernelParams = bindUserInputs(bindMutationInputs(polishSettingsIn.next(polishCenterIn).next(probeEnergyOut)));
+            std::vector<ParameterType> probeEnergies(polishCandidates * numProbes);
+            std::vector<ParameterType> centerEnergies(polishCandidates, std::numeric_limits<ParameterType>::max());
+            for (int round = 0; round < polishRounds; round++)
+            {
+                for (int firstProbe = 0; firstProbe < polishCandidates * numProbes; firstProbe += NumObjects)
+                {
+                    polishSettingsIn.access<ParameterType>(0) = firstProbe;
+                    computer.compute(kernelParams, "polishKernel", 0, numWorkGroupsToRun * workGroupThreads, workGroupThreads);
+                    for (int i = 0; i < NumObjects && firstProbe + i < polishCandidates * numProbes; i++)
+                        probeEnergies[firstProbe + i] = probeEnergyOut.access<ParameterType>(i * workGroupThreads);
+                }
+
+                for (int c = 0; c < polishCandidates; c++)
+                {
+                    // last probe is the center itself
+                    centerEnergies[c] = probeEnergies[c * numProbes + numProbes - 1];
+                    int bestProbe = -1;
+                    for (int p = 0; p < numProbes - 1; p++)
+                    {
+                        if (probeEnergies[c * numProbes + p] < centerEnergies[c])
+                        {
+                            centerEnergies[c] = probeEnergies[c * numProbes + p];
+                            bestProbe = p;
+                        }
+                    }
+
+                    ParameterType& step = polishSettingsIn.access<ParameterType>(1 + c);
+                    if (bestProbe >= 0)
+                    {
+                        ParameterType scaledStep = ((bestProbe & 1) ? -step : step);
+                        if (parameterStepScales.size() > 0)
+                            scaledStep *= stepScaleIn.access<ParameterType>(bestProbe / 2);
+                        ParameterType& value = polishCenterIn.access<ParameterType>(bestProbe / 2 + c * NumParameters);
+                        value += std::fmod(scaledStep, (ParameterType)1.0);
+                        value -= std::floor(value);
+                    }
+                    else
+                        step *= 0.5;
+                }
+            }
+
+            int bestCandidate = 0;
+            for (int c = 1; c < polishCandidates; c++)
+                if (centerEnergies[c] < centerEnergies[bestCandidate])
+                    bestCandidate = c;
+            for (int j = 0; j < NumParameters; j++)
+                result[j] = polishCenterIn.access<ParameterType>(j + bestCandidate * NumParameters);
+            return centerEnergies[bestCandidate];
+        }
+
+        // multi-fidelity annealing: energy loops written with parallelForFidelity visit only every stride-th item
+        // stride is maxStride at temperatureStart and goes down to 1 (all items) at temperatureStop
+        // best candidate of a subsampled iteration is re-scored at full fidelity before it is accepted
+        // energy needs to be a sum of terms computed only inside parallelForFidelity (no constant terms)
+        void setMultiFidelity(int maxStride = 64)
+        {
+            if (maxStride < 1)
+                throw std::invalid_argument("Error: maximum fidelity stride must be at least 1.");
+            fidelityMaxStride = maxStride;
+        }
+
+        // same as addUserInput but data is split between devices instead of copying whole data to all devices (for datasets that do not fit in memory of a single device)
+        // device i holds i-th consecutive part (shard) of data and computes partial energies of all objects over its shard, partial energies are summed on host before selection
+        // energy code visits shard items with parallelForShard, loopId indexes sharded inputs (shardFirstItem + loopId = index in whole data)
+        // all sharded inputs need to have same number of elements, devices compute equal parts without load-balancing
+        // energy needs to be a sum of per-item terms (computed only inside parallelForShard) and it can not be combined with multi-fidelity, local refinement or multiple hints
+        // needs to be called before build(), if data with same name exists, it updates the data
+        template<typename T>
+        void addShardedUserInput(std::string customInputName, const std::vector<T>& customInput)
+        {
+            if (customInput.size() == 0)
+                throw std::invalid_argument("Error: sharded user input can not be empty.");
+            if (numShardedItems > 0 && customInput.size() != numShardedItems)
+                throw std::invalid_argument("Error: all sharded user inputs need to have same number of elements.");
+
+            const int existing = findUserInput(customInputName);
+            if (existing >= 0 && !userInputFullAccess[existing].isSharded())
+                throw std::invalid_argument("Error: a non-sharded user input with same name exists.");
+
+            if (existing < 0)
+            {
+                // shards have equal sizes (last shard is padded with zeros to the size of others)
+                numShards = computer.getNumDevices();
+                shardItems = (customInput.size() + numShards - 1) / numShards;
+                numShardedItems = customInput.size();
+                GPGPU::HostParameter buffer = computer.createArrayInputSharded<T>(customInputName, shardItems * numShards);
+                buffer = T();
+                buffer.copyDataFromPtr(customInput.data(), customInput.size(), 0);
+                registerUserInput(customInputName, buffer, userInputArgument<T>());
+                return;
+            }
+            userInputFullAccess[existing].copyDataFromPtr(customInput.data(), customInput.size(), 0);
+        }
+
+        // for tiny problems (NumParameters <= 8) with cheap energies: each work-item computes candidatesPerThread objects instead of a work-group computing 1 object
+        // energy code runs once per work-item on vector values: parameters[j] and energy are CandidateReal (float/double vector of candidatesPerThread lanes, lane k = k-th object of work-item)
+        // so energy code needs to use CandidateReal for values that depend on parameters, same code still compiles for other kernels (where CandidateReal is scalar)
+        // parallelFor, parallelForWithBarrier, parallelForFidelity and parallelForWithEarlyExit visit all items sequentially, threadId is 0, local memory helpers and barriers can not be used
+        // candidatesPerThread: 1, 2, 4 or 8, can not be combined with multi-fidelity, energy stages, sharded inputs or least squares objective
+        // needs to be called before build()
+        void enableThreadPerCandidate(int candidatesPerThreadPrm = 4)
+        {
+            if (NumParameters > 8)
+                throw std::invalid_argument("Error: thread-per-candidate kernel supports at most 8 parameters.");
+            if (candidatesPerThreadPrm != 1 && candidatesPerThreadPrm != 2 && candidatesPerThreadPrm != 4 && candidatesPerThreadPrm != 8)
+                throw std::invalid_argument("Error: candidates per thread needs to be 1, 2, 4 or 8.");
+            if (NumObjects % candidatesPerThreadPrm != 0)
+                throw std::invalid_argument("Error: NumObjects needs to be a multiple of candidates per thread.");
+            candidatesPerThread = candidatesPerThreadPrm;
+        }
+
+        // records wall-clock time, temperature, best energy and min/median/max energy of all objects per iteration of run(), to tune temperature schedule and number of reheats
+        // each run() starts a new trace, can be called any time (takes effect with next run())
+        void enableConvergenceTrace(bool enabled = true)
+        {
+            convergenceTracing = enabled;
+            populationEnergies.resize(enabled ? NumObjects : 0);
+        }
+
+        // convergence of last run() (empty when not enabled)
+        ConvergenceTrace getConvergenceTrace() const
+        {
+            return convergence;
+        }
+
+        // adds a kernel that runs after energy code of constructor (and after previous stages) in every iteration, all kernels of an iteration run as one multi-kernel step
+        // kernel boundary is a global synchronization: a stage can read everything that previous kernels wrote for its object (in state buffers of addStateBuffer)
+        // stage code is written like energy code (parameters, energy, threadId, objectId are defined, 1 work-group per object) and its energy is added to energy of previous kernels
+        // energyBound of a stage is current energy minus energy of previous kernels
+        // stages chain kernels, every stage still computes an object in 1 work-group (energy of an object is not split across work-groups)
+        // with multiple devices, all kernels of an object run on same device in an iteration (state buffers are per device and not merged)
+        // can not be combined with multi-fidelity, local refinement, multiple hints or sharded inputs, needs to be called before build()
+        void addEnergyStage(std::string stageCode)
+        {
+            energyStages.push_back(stageCode);
+        }
+
+        // per-object device-only buffer (NumObjects x elementsPerObject elements, not copied to/from host) that is shared by energy code and all energy stages
+        // object o uses elements [o x elementsPerObject, (o+1) x elementsPerObject), contents need to be written in same iteration before they are read
+        // needs to be called before build()
+        template<typename T>
+        void addStateBuffer(std::string name, size_t elementsPerObject)
+        {
+            if (elementsPerObject == 0)
+                throw std::invalid_argument("Error: state buffer needs at least 1 element per object.");
+            if (findUserInput(name) >= 0)
+                throw std::invalid_argument(std::string("Error: a user input or state buffer with same name exists: ") + name);
+            registerUserInput(name, computer.createArrayState<T>(name, NumObjects * elementsPerObject), userInputArgument<T>());
+        }
+
+        // built-in objective for models that are linear in features: energy = sum over points of (sum over j of coefficient_j x feature_j - target)^2
+        // features: numPoints x NumParameters values (row-major), targets: numPoints values, coefficient_j = coefficientMin + parameter_j x (coefficientMax - coefficientMin)
+        // candidatesPerWorkGroup > 1: each work-group mutates that many objects and evaluates all of them on tiles of data loaded once into local memory (residual sums stay in registers)
+        // so data traffic is shared by candidates (NumObjects needs to be a multiple of it, it is ignored when multi-fidelity is enabled)
+        // replaces energy code given to constructor, needs to be called before build(), calling again updates the data (same number of points)
+        void setLeastSquaresObjective(const std::vector<ParameterType>& features, const std::vector<ParameterType>& targets,
+            ParameterType coefficientMin = -10, ParameterType coefficientMax = 10, int candidatesPerWorkGroup = 4)
+        {
+            if (targets.size() == 0 || features.size() != targets.size() * NumParameters)
+                throw std::invalid_argument("Error: least squares objective needs numPoints x NumParameters features and numPoints targets.");
+            if (candidatesPerWorkGroup < 1 || NumObjects % candidatesPerWorkGroup != 0)
+                throw std::invalid_argument("Error: NumObjects needs to be a multiple of candidates per work-group.");
+            if (leastSquaresPoints > 0 && leastSquaresPoints != targets.size())
+                throw std::invalid_argument("Error: number of points of least squares objective can not change.");
+            if (leastSquaresPoints == 0 && findUserInput("leastSquaresFeatures") >= 0)
+                throw std::invalid_argument("Error: leastSquaresFeatures is a name reserved for least squares objective.");
+
+            leastSquaresMin = coefficientMin;
+            leastSquaresMax = coefficientMax;
+            candidatesPerGroup = candidatesPerWorkGroup;
+            if (leastSquaresPoints == 0)
+            {
+                leastSquaresPoints = targets.size();
+                registerUserInput("leastSquaresFeatures", computer.createArrayInput<ParameterType>("leastSquaresFeatures", features.size()), userInputArgument<ParameterType>());
+                registerUserInput("leastSquaresTargets", computer.createArrayInput<ParameterType>("leastSquaresTargets", targets.size()), userInputArgument<ParameterType>());
+            }
+            userInputFullAccess[findUserInput("leastSquaresFeatures")].copyDataFromPtr(features.data());
+            userInputFullAccess[findUserInput("leastSquaresTargets")].copyDataFromPtr(targets.data());
+
+            // same energy for kernels that evaluate 1 candidate per work-group (also used by hints, local refinement and multi-fidelity)
+            funcMin = R"(
+                parallelForFidelity(LeastSquaresPoints,
+                {
+                    GPGPU_REAL_VAL residual = -leastSquaresTargets[loopId];
+                    for(int j=0;j<NumParameters;j++)
+                        residual += (LeastSquaresMin + parameters[j] * (LeastSquaresMax - LeastSquaresMin)) * leastSquaresFeatures[(long)loopId * NumParameters + j];
+                    energy += residual * residual;
+                });
+            )";
+        }
+
+        // selects temperature schedule of run()
+        // an object accepts its move when its energy is lower than current energy, acceptance ratio is the accepted fraction of objects per iteration
+        // perObjectStepScaling: each object multiplies temperature with its own step scale, scale of an object grows when it accepts more often than target ratio and shrinks otherwise
+        // needs to be called before build()
+        void setCoolingSchedule(CoolingSchedule schedule, double targetAcceptance = 0.2, bool perObjectStepScalingPrm = false)
+        {
+            if (targetAcceptance <= 0.0 || targetAcceptance >= 1.0)
+                throw std::invalid_argument("Error: target acceptance ratio must be in (0,1) range.");
+            // acceptance of an object is written next to its energy
+            if (schedule != COOLING_REHEAT_ON_IMPROVEMENT && workGroupThreads < 2)
+                throw std::invalid_argument("Error: cooling schedules with acceptance counting require at least 2 gpu threads per object.");
+            coolingSchedule = schedule;
+            targetAcceptanceRatio = targetAcceptance;
+            perObjectStepScaling = perObjectStepScalingPrm;
+        }
+
+        // polishes current state (and numCandidates - 1 best objects of last iteration) with pattern search whenever temperature reaches temperatureStop (before each reheat and at the end)
+        // search starts with step = temperatureStop (multiplied by per-parameter step scales) and each round halves step of a candidate that does not improve
+        // uses same energy code, each work-group computes 1 probe point
+        // can not be combined with multi-fidelity annealing
+        // needs to be called before build()
+        void enableLocalRefinement(int rounds = 10, int numCandidates = 1)
+        {
+            if (rounds < 1)
+                throw std::invalid_argument("Error: number of local refinement rounds must be at least 1.");
+            if (numCandidates < 1 || numCandidates > NumObjects)
+                throw std::invalid_argument("Error: number of local refinement candidates must be between 1 and NumObjects.");
+            polishRounds = rounds;
+            polishCandidates = numCandidates;
+        }
+
+        // number of accepted moves of each object during last run()
+        std::vector<int> getAcceptanceCounts()
+        {
+            return acceptanceCounts;
+        }
+
+        // enables mutations that are correlated between parameters (helps ill-conditioned problems where parameters depend on each other, like polynomial coefficients)
+        // last "rank" accepted moves form a low-rank factor of mutation covariance and a part of each mutation is sampled along it with gaussian weights
+        // rank: number of accepted moves remembered (maximum = gpuThreadsPerObject)
+        // correlatedRatio: 0 = only independent per-parameter mutations, 1 = only correlated mutations
+        // needs to be called before build()
+        void enableCorrelatedMutation(int rank = 8, ParameterType correlatedRatio = 0.5f)
+        {
+            if (rank < 1 || rank > workGroupThreads)
+                throw std::invalid_argument("Error: rank of correlated mutation must be between 1 and gpuThreadsPerObject.");
+            correlatedMutationRank = rank;
+            correlatedMutationRatio = correlatedRatio;
+        }
+
+        void build()
+        {
+            buildConstants<ParameterType>(numShards);
+            constants += std::string(R"(
+            #define CorrelatedMutationRank )") + std::to_string(correlatedMutationRank) + std::string(R"(
+            #define CorrelatedMutationRatio ((GPGPU_REAL_VAL))") + kernelReal(correlatedMutationRatio) + std::string(R"()
+            #define CountAcceptance )") + std::to_string(coolingSchedule != COOLING_REHEAT_ON_IMPROVEMENT ? 1 : 0) + std::string(R"(
+            #define UseObjectStepScales )") + std::to_string(perObjectStepScaling ? 1 : 0) + std::string(R"(
+            #define NumShardedItems )") + std::to_string(numShardedItems) + std::string(R"(L
+            #define ShardItems )") + std::to_string(shardItems) + std::string(R"(L
+        )");
+            if (numShardedItems > 0 && (fidelityMaxStride > 1 || polishRounds > 0))
+                throw std::invalid_argument("Error: sharded user inputs can not be used with multi-fidelity or local refinement.");
+            if (numShardedItems > 0 && leastSquaresPoints > 0)
+                throw std::invalid_argument("Error: sharded user inputs can not be used with least squares objective.");
+            // full-fidelity rescore of a subsampled iteration overwrites the candidates that refinement polishes
+            if (fidelityMaxStride > 1 && polishRounds > 0)
+                throw std::invalid_argument("Error: local refinement can not be used with multi-fidelity.");
+
+            if (energyStages.size() > 0 && (numShardedItems > 0 || fidelityMaxStride > 1 || polishRounds > 0))
+                throw std::invalid_argument("Error: energy stages can not be used with sharded user inputs, multi-fidelity or local refinement.");
+            if (candidatesPerThread > 0 && (numShardedItems > 0 || fidelityMaxStride > 1 || energyStages.size() > 0 || leastSquaresPoints > 0))
+                throw std::invalid_argument("Error: thread-per-candidate kernel can not be used with sharded user inputs, multi-fidelity, energy stages or least squares objective.");
+
+            // multi-fidelity energy is computed per work-group so batched candidates are only used without it
+            if (leastSquaresPoints == 0 || fidelityMaxStride > 1 || energyStages.size() > 0)
+                candidatesPerGroup = 1;
+            std::string energyCode = funcMin;
+            if (leastSquaresPoints > 0)
+            {
+                // data tile (features + target of each point) fits in 16kB of local memory
+                const int tilePoints = (int)std::max((size_t)1, std::min(leastSquaresPoints, (16384 / sizeof(ParameterType)) / (NumParameters + 1)));
+                constants += std::string(R"(
+            #define LeastSquaresPoints )") + std::to_string(leastSquaresPoints) + std::string(R"(
+            #define LeastSquaresTile )") + std::to_string(tilePoints) + std::string(R"(
+            #define LeastSquaresMin ((GPGPU_REAL_VAL))") + kernelReal(leastSquaresMin) + std::string(R"()
+            #define LeastSquaresMax ((GPGPU_REAL_VAL))") + kernelReal(leastSquaresMax) + std::string(R"()
+        )");
+                if (candidatesPerGroup > 1)
+                    energyCode = R"(
+                local GPGPU_REAL_VAL leastSquaresCoefficients[NumParameters * CandidatesPerGroup];
+                local GPGPU_REAL_VAL featureTile[LeastSquaresTile * NumParameters];
+                local GPGPU_REAL_VAL targetTile[LeastSquaresTile];
+                for(int i=localId;i<NumParameters * CandidatesPerGroup;i+=WorkGroupThreads)
+                    leastSquaresCoefficients[i] = LeastSquaresMin + parameters[i] * (LeastSquaresMax - LeastSquaresMin);
+
+                // each point of a tile is read once from local memory for all candidates of work-group
+                GPGPU_REAL_VAL candidateEnergies[CandidatesPerGroup];
+                for(int c=0;c<CandidatesPerGroup;c++)
+                    candidateEnergies[c] = GPGPU_ZERO_REAL_VAL;
+                for(int firstPoint=0;firstPoint<LeastSquaresPoints;firstPoint+=LeastSquaresTile)
+                {
+                    const int tilePoints = min(LeastSquaresTile, LeastSquaresPoints - firstPoint);
+                    tileLoad(featureTile, leastSquaresFeatures, (long)firstPoint * NumParameters, tilePoints * NumParameters);
+                    tileLoad(targetTile, leastSquaresTargets, firstPoint, tilePoints);
+                    for(int point=localId;point<tilePoints;point+=WorkGroupThreads)
+                    {
+                        GPGPU_REAL_VAL residuals[CandidatesPerGroup];
+                        for(int c=0;c<CandidatesPerGroup;c++)
+                            residuals[c] = -targetTile[point];
+                        for(int j=0;j<NumParameters;j++)
+                        {
+                            const GPGPU_REAL_VAL feature = featureTile[point * NumParameters + j];
+                            for(int c=0;c<CandidatesPerGroup;c++)
+                                residuals[c] += leastSquaresCoefficients[j + c * NumParameters] * feature;
+                        }
+                        for(int c=0;c<CandidatesPerGroup;c++)
+                            candidateEnergies[c] += residuals[c] * residuals[c];
+                    }
+                }
+            )";
+            }
+            constants += std::string(R"(
+            #define CandidatesPerGroup )") + std::to_string(candidatesPerGroup) + std::string(R"(
+            #define NumEnergyStages )") + std::to_string(energyStages.size()) + std::string(R"(
+        )");
+
+            const std::string mainArguments = std::string(R"(global unsigned int * randomCounterIn, global GPGPU_REAL_VAL * tempIn, global GPGPU_REAL_VAL * energyOut, global GPGPU_REAL_VAL * parameterIn, global GPGPU_REAL_VAL * parameterOut )") + (correlatedMutationRank > 0 ? std::string(", global GPGPU_REAL_VAL * mutationFactorIn") : std::string()) + (perObjectStepScaling ? std::string(", global GPGPU_REAL_VAL * objectStepScaleIn") : std::string()) + (energyStages.size() > 0 ? std::string(", global GPGPU_REAL_VAL * stageCandidates") : std::string()) + mutationArguments() + userInputs;
+
+            kernel = constants + helperFunctions() + std::string(R"(
+
+            kernel void kernelFunction()") + mainArguments + std::string(R"()
+            {
+                const GPGPU_INDEX id = get_global_id(0);
+                // a work-group computes CandidatesPerGroup consecutive objects starting from groupId
+                // work-groups of shard s compute same candidates (randomness depends only on object) over items of shard s
+                const int outputGroupId = id / WorkGroupThreads;
+                const int groupId = (outputGroupId % (NumObjects / CandidatesPerGroup)) * CandidatesPerGroup;
+                const int shardId = outputGroupId / (NumObjects / CandidatesPerGroup);
+                const long shardFirstItem = shardId * ShardItems;
+                const long shardNumItems = min(ShardItems, max(0L, NumShardedItems - shardFirstItem));
+                const int localId = id % WorkGroupThreads;
+                local GPGPU_REAL_VAL parameters[NumParameters * CandidatesPerGroup];
+                local GPGPU_REAL_VAL energies[WorkGroupThreads];
+                local GPGPU_REAL_VAL earlyExitEnergy[WorkGroupThreads];
+#if UseObjectStepScales
+                const GPGPU_REAL_VAL temperature = tempIn[0] * objectStepScaleIn[groupId];
+#else
+                const GPGPU_REAL_VAL temperature = tempIn[0];
+#endif
+                const int numLoopIter = (NumParameters / WorkGroupThreads) + 1;
+                const unsigned int iteration = randomCounterIn[0];
+                const unsigned int randomKey = randomCounterIn[1];
+                const GPGPU_REAL_VAL gpgpuHalf = 0.5;
+#if CorrelatedMutationRank > 0
+                local GPGPU_REAL_VAL correlatedWeights[CorrelatedMutationRank];
+#endif
+                for(int candidate=0;candidate<CandidatesPerGroup;candidate++)
+                {
+                    const int candidateObject = groupId + candidate;
+#if UseObjectStepScales
+                    const GPGPU_REAL_VAL candidateTemperature = tempIn[0] * objectStepScaleIn[candidateObject];
+#else
+                    const GPGPU_REAL_VAL candidateTemperature = tempIn[0];
+#endif
+#if CorrelatedMutationRank > 0
+                    // gaussian weights (Box-Muller) of low-rank factor rows, shared by all parameters of this object
+                    // streams after the parameter streams are used for the weights
+                    if(localId < CorrelatedMutationRank)
+                    {
+                        const Philox4x32 randomValues = philox(candidateObject, NumParameters + localId, iteration, 0, randomKey, 0);
+                        const GPGPU_REAL_VAL u1 = randomOpen(randomValues.x);
+                        const GPGPU_REAL_VAL u2 = random(randomValues.y);
+                        correlatedWeights[localId] = sqrt(-2.0f * log(u1)) * cos((GPGPU_REAL_VAL)(2.0f * M_PI_F) * u2);
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+#endif
+                    for(int i=0;i<numLoopIter;i++)
+                    {
+                        const int loopId = localId + WorkGroupThreads * i;
+                        if(loopId < NumParameters)
+                        {
+                            const Philox4x32 randomValues = philox(candidateObject, loopId, iteration, 0, randomKey, 0);
+                            GPGPU_REAL_VAL change = mutationStep(randomValues.x, randomValues.y)*candidateTemperature;
+#if CorrelatedMutationRank > 0
+                            GPGPU_REAL_VAL correlatedChange = GPGPU_ZERO_REAL_VAL;
+                            for(int k=0;k<CorrelatedMutationRank;k++)
+                                correlatedChange += correlatedWeights[k] * mutationFactorIn[loopId + k * NumParameters];
+                            change = change * (1.0f - CorrelatedMutationRatio) + correlatedChange * candidateTemperature * CorrelatedMutationRatio;
+#endif
+#if UseParameterStepScales
+                            change *= stepScaleIn[loopId];
+#endif
+
+                            parameters[loopId + candidate * NumParameters] = wrapNormalized(parameterIn[loopId], change);
+                        }
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+
+                // subsampled energy: all objects visit same subset (rotated per iteration) and energy is scaled up to full dataset
+                // full-fidelity rescore: all objects evaluate same candidate on disjoint subsets and host sums them
+                const int fidelityRescore = tempIn[3] > gpgpuHalf;
+                const int fidelityStride = (int)(tempIn[2] + gpgpuHalf);
+                const int fidelityOffset = fidelityRescore ? groupId : (int)(iteration % fidelityStride);
+                const GPGPU_REAL_VAL fidelityScale = fidelityRescore ? (GPGPU_REAL_VAL)1.0 : (GPGPU_REAL_VAL)fidelityStride;
+
+                // candidates with higher energy than current energy are not accepted
+                const GPGPU_REAL_VAL energyBound = tempIn[1] / fidelityScale;
+
+                // objective function by user                
+                GPGPU_REAL_VAL energy = GPGPU_ZERO_REAL_VAL;
+                const int threadId = localId;
+                const int objectId = groupId;
+                )") + energyCode + std::string(R"(
+                // objective function end
+
+                for(int candidate=0;candidate<CandidatesPerGroup;candidate++)
+                {
+#if CandidatesPerGroup > 1
+                    energies[localId] = candidateEnergies[candidate];
+#else
+                    energies[localId] = energy;
+#endif
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                    for(unsigned int i=WorkGroupThreads/2;i>=1;i>>=1)
+                    {
+                        unsigned int reduceId = i + localId;
+                        if(localId<i)
+                            energies[localId] += energies[reduceId]; 
+                        barrier(CLK_LOCAL_MEM_FENCE);
+                    }
+                    const GPGPU_INDEX outputObject = (GPGPU_INDEX)shardId * NumObjects + groupId + candidate;
+                    if(localId == 0)
+                    {
+                        energyOut[outputObject * WorkGroupThreads]=energies[0] * fidelityScale;
+#if CountAcceptance
+                        // acceptance of this object (move is better than current energy = tempIn[1])
+                        energyOut[outputObject * WorkGroupThreads + 1] = (energies[0] * fidelityScale < tempIn[1]) ? (GPGPU_REAL_VAL)1.0 : GPGPU_ZERO_REAL_VAL;
+#endif
+#if NumEnergyStages > 0
+                        stageCandidates[outputObject * (NumParameters + 1) + NumParameters] = energies[0];
+#endif
+                    }
+
+                    for(int i=0;i<numLoopIter;i++)
+                    {
+                        const int loopId = localId + WorkGroupThreads * i;
+                        const GPGPU_INDEX arrayId = loopId + outputObject*WorkGroupThreads*NumParamsPerThread;
+                        if(loopId < NumParameters)
+                        {
+                            parameterOut[arrayId] = parameters[loopId + candidate * NumParameters];
+#if NumEnergyStages > 0
+                            stageCandidates[outputObject * (NumParameters + 1) + loopId] = parameters[loopId];
+#endif
+                        }
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+            }
+        )");
+            // energy stage kernels: candidate and its energy so far are read from stageCandidates, stage energy is added
+            for (size_t stage = 0; stage < energyStages.size(); stage++)
+            {
+                kernel += std::string(R"(
+            kernel void energyStage)") + std::to_string(stage) + std::string(R"((global GPGPU_REAL_VAL * tempIn, global GPGPU_REAL_VAL * stageCandidates, global GPGPU_REAL_VAL * energyOut )") + userInputs + std::string(R"()
+            {
+                const GPGPU_INDEX id = get_global_id(0);
+                const int groupId = id / WorkGroupThreads;
+                const int localId = id % WorkGroupThreads;
+                local GPGPU_REAL_VAL parameters[NumParameters];
+                local GPGPU_REAL_VAL energies[WorkGroupThreads];
+                local GPGPU_REAL_VAL earlyExitEnergy[WorkGroupThreads];
+                const int numLoopIter = (NumParameters / WorkGroupThreads) + 1;
+                for(int i=0;i<numLoopIter;i++)
+                {
+                    const int loopId = localId + WorkGroupThreads * i;
+                    if(loopId < NumParameters)
+                    {
+                        parameters[loopId] = stageCandidates[loopId + (GPGPU_INDEX)groupId * (NumParameters + 1)];
+                    }
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                const int fidelityStride = 1;
+                const int fidelityOffset = 0;
+                const GPGPU_REAL_VAL previousEnergy = stageCandidates[NumParameters + (GPGPU_INDEX)groupId * (NumParameters + 1)];
+                const GPGPU_REAL_VAL energyBound = tempIn[1] - previousEnergy;
+
+                // energy stage by user
+                GPGPU_REAL_VAL energy = GPGPU_ZERO_REAL_VAL;
+                const int threadId = localId;
+                const int objectId = groupId;
+                )") + energyStages[stage] + std::string(R"(
+                energies[localId] = energy;
+                // energy stage end
+
+                barrier(CLK_LOCAL_MEM_FENCE);
+                for(unsigned int i=WorkGroupThreads/2;i>=1;i>>=1)
+                {
+                    unsigned int reduceId = i + localId;
+                    if(localId<i)
+                        energies[localId] += energies[reduceId]; 
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+                if(localId == 0)
+                {
+                    const GPGPU_REAL_VAL totalEnergy = previousEnergy + energies[0];
+                    stageCandidates[NumParameters + (GPGPU_INDEX)groupId * (NumParameters + 1)] = totalEnergy;
+                    energyOut[id] = totalEnergy;
+#if CountAcceptance
+                    energyOut[id+1] = (totalEnergy < tempIn[1]) ? (GPGPU_REAL_VAL)1.0 : GPGPU_ZERO_REAL_VAL;
+#endif
+                }
+            }
+        )");
+            }
+
+            if (polishRounds > 0)
+            {
+                kernel += std::string(R"(
+            #define PolishCandidates )") + std::to_string(polishCandidates) + std::string(R"(
+
+            kernel void polishKernel(global GPGPU_REAL_VAL * polishSettingsIn, global GPGPU_REAL_VAL * polishCenterIn, global GPGPU_REAL_VAL * energyOut )") + mutationArguments() + userInputs + std::string(R"()
+            {
+                const GPGPU_INDEX id = get_global_id(0);
+                const int groupId = id / WorkGroupThreads;
+                const int localId = id % WorkGroupThreads;
+                local GPGPU_REAL_VAL parameters[NumParameters];
+                local GPGPU_REAL_VAL energies[WorkGroupThreads];
+                local GPGPU_REAL_VAL earlyExitEnergy[WorkGroupThreads];
+                const GPGPU_REAL_VAL gpgpuHalf = 0.5;
+                const int numLoopIter = (NumParameters / WorkGroupThreads) + 1;
+
+                // probe = center of a candidate moved by +step or -step along one parameter, last probe of a candidate is the center itself
+                const int numProbes = 2 * NumParameters + 1;
+                const int probeId = (int)(polishSettingsIn[0] + gpgpuHalf) + groupId;
+                const int candidate = min(probeId / numProbes, PolishCandidates - 1);
+                const int probe = (probeId / numProbes < PolishCandidates) ? (probeId % numProbes) : (numProbes - 1);
+                const int probeParameter = probe / 2;
+                const GPGPU_REAL_VAL step = (probe & 1) ? -polishSettingsIn[1 + candidate] : polishSettingsIn[1 + candidate];
+                for(int i=0;i<numLoopIter;i++)
+                {
+                    const int loopId = localId + WorkGroupThreads * i;
+                    if(loopId < NumParameters)
+                    {
+                        const GPGPU_REAL_VAL center = polishCenterIn[loopId + candidate * NumParameters];
+#if UseParameterStepScales
+                        parameters[loopId] = (loopId == probeParameter) ? wrapNormalized(center, step * stepScaleIn[loopId]) : center;
+#else
+                        parameters[loopId] = (loopId == probeParameter) ? wrapNormalized(center, step) : center;
+#endif
+                    }
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                const int fidelityStride = 1;
+                const int fidelityOffset = 0;
+                const GPGPU_REAL_VAL energyBound = (GPGPU_REAL_VAL)INFINITY;
+
+                // objective function by user
+                GPGPU_REAL_VAL energy = GPGPU_ZERO_REAL_VAL;
+                const int threadId = localId;
+                const int objectId = groupId;
+                )") + funcMin + std::string(R"(
+                energies[localId] = energy;
+                // objective function end
+
+                barrier(CLK_LOCAL_MEM_FENCE);
+                for(unsigned int i=WorkGroupThreads/2;i>=1;i>>=1)
+                {
+                    unsigned int reduceId = i + localId;
+                    if(localId<i)
+                        energies[localId] += energies[reduceId]; 
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+                if(localId == 0)
+                    energyOut[id]=energies[0];
+            }
+        )");
+            }
+
+            computer.compile(kernel, "kernelFunction");
+            if (candidatesPerThread > 0)
+            {
+                // largest power of 2 (up to 64) that divides number of work-items
+                vectorLocalThreads = 1;
+                while (vectorLocalThreads < 64 && (NumObjects / candidatesPerThread) % (vectorLocalThreads * 2) == 0)
+                    vectorLocalThreads *= 2;
+                computer.compile(vectorKernel(mainArguments), "kernelFunctionVector");
+            }
+            for (size_t stage = 0; stage < energyStages.size(); stage++)
+                computer.compile(kernel, std::string("energyStage") + std::to_string(stage));
+            if (energyStages.size() > 0)
+                stageCandidates = computer.createArrayState<ParameterType>("stageCandidates", NumObjects * (NumParameters + 1));
+            hintKernelCompiled = false;
+            if (polishRounds > 0)
+            {
+                computer.compile(kernel, "polishKernel");
+                polishSettingsIn = computer.createArrayInput<ParameterType>("polishSettingsIn", 1 + polishCandidates);
+                polishCenterIn = computer.createArrayInput<ParameterType>("polishCenterIn", polishCandidates * NumParameters);
+            }
+            createMutationInputs<ParameterType>();
+            createRandomInputs();
+            // partial energies (and parameters) of all objects per shard
+            // elements per work-item: work-group computes candidatesPerGroup objects, thread-per-candidate work-item computes candidatesPerThread objects (compact, only its own values)
+            objectEnergyStride = (candidatesPerThread > 0) ? 2 : workGroupThreads;
+            objectParameterStride = (candidatesPerThread > 0) ? NumParameters : numParametersItersPerWorkgroupWithUnused * workGroupThreads;
+            const size_t energiesPerWorkItem = (candidatesPerThread > 0) ? candidatesPerThread * objectEnergyStride : candidatesPerGroup;
+            const size_t parametersPerWorkItem = (candidatesPerThread > 0) ? candidatesPerThread * objectParameterStride : numParametersItersPerWorkgroupWithUnused * candidatesPerGroup;
+            energyOut = computer.createArrayOutput<ParameterType>("energyOut", numShards * numWorkGroupsToRun * objectEnergyStride, energiesPerWorkItem);
+            // energies of hint and local refinement kernels (1 object per work-group)
+            probeEnergyOut = computer.createArrayOutput<ParameterType>("probeEnergyOut", numWorkGroupsToRun * workGroupThreads);
+
+            parameterIn = computer.createArrayInput<ParameterType>("parameterIn", NumParameters);
+            // temperature, current energy, fidelity stride, full-fidelity rescore
+            temperatureIn = computer.createArrayInput<ParameterType>("tempIn", 4);
+            if (perObjectStepScaling)
+                objectStepScaleIn = computer.createArrayInput<ParameterType>("objectStepScaleIn", NumObjects);
+            if (correlatedMutationRank > 0)
+            {
+                mutationFactorIn = computer.createArrayInput<ParameterType>("mutationFactorIn", correlatedMutationRank * NumParameters);
+                for (int i = 0; i < correlatedMutationRank * NumParameters; i++)
+                    mutationFactorIn.access<ParameterType>(i) = 0;
+            }
+            parameterOut = computer.createArrayOutput<ParameterType>("parameterOut",
+                numShards * numWorkGroupsToRun * objectParameterStride, parametersPerWorkItem);
+        }
+
+        // userHintForInitialParametersNormalized: 1 hint vector (NumParameters values) or M hint vectors concatenated (M x NumParameters values)
+        // M hints are scored together (1 hint per work-group) and annealing starts from the lowest-energy hint
+        std::vector<ParameterType> run(
+            const ParameterType temperatureStart = 1.0f, const ParameterType temperatureStop = 0.01f, const ParameterType temperatureDivider = 2.0f,
+            const int numReheats = 5,
+            const bool debug = false, const bool deviceDebug = false, const bool energyDebug = false,
+            std::function<void(ParameterType*)> callbackLowerEnergyFound = [](ParameterType*) {},
+            std::vector<ParameterType> userHintForInitialParametersNormalized = std::vector<ParameterType>()
+        )
+        {
+
+            std::random_device rd;
+            std::mt19937 rng{ rd() };
+            std::uniform_real_distribution<float> uid(0.0f, 1.0f);
+            CallbackDispatcher<ParameterType> improvementCallback(callbackLowerEnergyFound, NumParameters, callbackQueueCapacity);
+
+
+
+            // hints are not used when continuing from a checkpoint
+            if (resumePending)
+                userHintForInitialParametersNormalized.clear();
+            if ((numShardedItems > 0 || energyStages.size() > 0) && userHintForInitialParametersNormalized.size() > NumParameters)
+                throw std::invalid_argument("Error: multiple hints can not be used with sharded user inputs or energy stages.");
+            if (!(temperatureDivider > 1))
+                throw std::invalid_argument("Error: temperature divider must be greater than 1.");
+
+            const auto runStart = std::chrono::steady_clock::now();
+            convergence.clear();
+            int reheat = numReheats;
+            auto kernelParams = randomCounterIn.next(temperatureIn).next(energyOut).next(parameterIn).next(parameterOut);
+            if (correlatedMutationRank > 0)
+                kernelParams = kernelParams.next(mutationFactorIn);
+            if (perObjectStepScaling)
+            {
+                kernelParams = kernelParams.next(objectStepScaleIn);
+                for (int i = 0; i < NumObjects && !resumePending; i++)
+                    objectStepScaleIn.access<ParameterType>(i) = 1;
+            }
+            if (energyStages.size() > 0)
+                kernelParams = kernelParams.next(stageCandidates);
+            for (int i = 0; i < NumObjects && !resumePending; i++)
+                acceptanceCounts[i] = 0;
+            kernelParams = bindUserInputs(bindMutationInputs(kernelParams));
+
+            // initial guess for parameters (middle-points for all dimensions or user hint)
+            if (userHintForInitialParametersNormalized.size() == NumParameters)
+            {
+                for (int i = 0; i < NumParameters; i++)
+                {
+                    parameterIn.access<ParameterType>(i) = userHintForInitialParametersNormalized[i];
+                }
+            }
+            else
+            {
+                for (int i = 0; i < NumParameters; i++)
+                {
+                    parameterIn.access<ParameterType>(i) = 0.5f;
+                }
+            }
+
+            ParameterType temp = temperatureStart;
+            ParameterType foundEnergy = std::numeric_limits<ParameterType>::max();
+
+            // compute user-hinted parameters first
+            if (userHintForInitialParametersNormalized.size() == NumParameters)
+            {
+                // to compute with hint parameters exactly, set temperature to zero
+                setLaunchSettings(0, foundEnergy, 1, false);
+                advanceRandomCounter();
+                computeObjects(kernelParams);
+                // get energy of hint
+                foundEnergy = objectEnergy(0);
+            }
+            else if (userHintForInitialParametersNormalized.size() > NumParameters && userHintForInitialParametersNormalized.size() % NumParameters == 0)
+            {
+                foundEnergy = scoreHints(userHintForInitialParametersNormalized);
+                for (int i = 0; i < NumParameters; i++)
+                {
+                    currentParameters[i] = parameterIn.access<ParameterType>(i);
+                    bestParameters[i] = currentParameters[i];
+                }
+                if (energyDebug)
+                    std::cout << "lowest energy of hints: " << foundEnergy << std::endl;
+            }
+
+
+            ParameterType bestEnergy = foundEnergy;
+            if (resumePending)
+            {
+                for (int i = 0; i < NumParameters; i++)
+                    parameterIn.access<ParameterType>(i) = currentParameters[i];
+                temp = runTemperature;
+                reheat = runReheatsLeft;
+                foundEnergy = runCurrentEnergy;
+                bestEnergy = runBestEnergy;
+                resumePending = false;
+            }
+
+            // initialize temperature
+            temperatureIn.access<ParameterType>(0) = temp;
+
+
+            int foundId = -1;
+            int iter = 0;
+            int foundIdBest = -1;
+            size_t iterationsDone = 0;
+
+            std::vector<double> perf;
+            size_t measuredNanoSecTot = 0;
+            {
+                GPGPU::Bench benchTot(&measuredNanoSecTot);
+                while (temp > temperatureStop)
+                {
+                    if (debug)
+                        std::cout << "iteration-" << iter++ << std::endl;
+                    bool foundBetterEnergy = false;
+                    bool foundBestEnergy = false;
+                    size_t measuredNanoSec = 0;
+                    bool doNotHeat = false;
+                    const ParameterType launchTemperature = temp;
+                    const int launchReheatsLeft = reheat;
+                    int numAccepted = 0;
+                    const int fidelityStride = fidelityStrideOf(launchTemperature, temperatureStart, temperatureStop);
+                    {
+                        GPGPU::Bench bench(&measuredNanoSec);
+                        setLaunchSettings(launchTemperature, foundEnergy, fidelityStride, false);
+                        advanceRandomCounter();
+                        perf = computeObjects(kernelParams);
+                        measureDevices(objectsKernelNames());
+
+                        ParameterType tmpEn = std::numeric_limits<double>::max();
+                        int tmpI = -1;
+
+                        for (int i = 0; i < NumObjects; i++)
+                        {
+                            const ParameterType energy = resultEnergy(i);
+                            if (tmpEn > energy)
+                            {
+                                tmpEn = energy;
+                                tmpI = i;
+                            }
+                            if (convergenceTracing)
+                                populationEnergies[i] = energy;
+                            if (coolingSchedule != COOLING_REHEAT_ON_IMPROVEMENT)
+                            {
+                                // acceptance flags of shards are computed from partial energies so sharded acceptance is decided on host
+                                const int accepted = (numShardedItems > 0) ? (energy < foundEnergy) : resultAccepted(i);
+                                acceptanceCounts[i] += accepted;
+                                numAccepted += accepted;
+                                if (perObjectStepScaling)
+                                    objectStepScaleIn.access<ParameterType>(i) *= std::pow(temperatureDivider, 0.25 * (accepted - targetAcceptanceRatio));
+                            }
+                        }
+
+                        // global temperature follows the mean step size so per-object scales are kept relative (geometric mean = 1)
+                        if (perObjectStepScaling)
+                        {
+                            double logMean = 0;
+                            for (int i = 0; i < NumObjects; i++)
+                                logMean += std::log(objectStepScaleIn.access<ParameterType>(i));
+                            const double normalizer = std::exp(-logMean / NumObjects);
+                            for (int i = 0; i < NumObjects; i++)
+                                objectStepScaleIn.access<ParameterType>(i) *= normalizer;
+                        }
+
+                        // subsampled energy of best candidate is only an estimate, it is accepted by its full-fidelity energy
+                        if (fidelityStride > 1 && foundEnergy > tmpEn && tmpI >= 0)
+                        {
+                            std::vector<ParameterType> current(NumParameters);
+                            for (int i = 0; i < NumParameters; i++)
+                            {
+                                current[i] = parameterIn.access<ParameterType>(i);
+                                parameterIn.access<ParameterType>(i) = resultParameter(tmpI, i);
+                            }
+
+                            // all objects compute same candidate (at zero temperature) on disjoint subsets of items, so all of them output the candidate
+                            setLaunchSettings(0, foundEnergy, NumObjects, true);
+                            computer.compute(kernelParams, "kernelFunction", 0, numWorkGroupsToRun * workGroupThreads, workGroupThreads);
+                            tmpEn = 0;
+                            for (int i = 0; i < NumObjects; i++)
+                                tmpEn += objectEnergy(i);
+
+                            for (int i = 0; i < NumParameters; i++)
+                                parameterIn.access<ParameterType>(i) = current[i];
+                            setLaunchSettings(launchTemperature, foundEnergy, fidelityStride, false);
+                        }
+
+                        if (foundEnergy > tmpEn && tmpI >= 0)
+                        {
+                            foundEnergy = tmpEn;
+                            foundId = tmpI;
+                            foundBetterEnergy = true;
+                            if (bestEnergy > tmpEn)
+                            {
+                                bestEnergy = tmpEn;
+                                foundIdBest = tmpI;
+                                foundBestEnergy = true;
+                            }
+                        }
+                        else if (false && tmpI >= 0)
+                        {
+                            doNotHeat = true;
+                            double rnd0 = uid(rng);
+                            double dE = std::abs(foundEnergy - tmpEn) / std::abs(std::numeric_limits<double>::min() + foundEnergy);
+
+                            if (rnd0 < std::exp(-dE / (temp * 0.1)))
+                            {
+                                foundEnergy = tmpEn;
+                                foundId = tmpI;
+                                foundBetterEnergy = true;
+                            }
+                        }
+                    }
+                    if (foundBetterEnergy)
+                    {
+                        if (!doNotHeat && coolingSchedule == COOLING_REHEAT_ON_IMPROVEMENT)
+                            temp *= std::pow(temperatureDivider, 2.0); // as long as better states are found, temperature can be kept high
+
+
+                        for (int i = 0; i < NumParameters; i++)
+                        {
+                            currentParameters[i] = resultParameter(foundId, i);
+                        }
+
+                        if (foundBestEnergy)
+                        {
+                            for (int i = 0; i < NumParameters; i++)
+                            {
+                                bestParameters[i] = resultParameter(foundIdBest, i);
+                            }
+                        }
+
+                        if (correlatedMutationRank > 0)
+                            recordAcceptedMove(launchTemperature);
+
+                        // new low-energy point becomes new guess for next iteration
+                        for (int i = 0; i < NumParameters; i++)
+                        {
+                            parameterIn.access<ParameterType>(i) = currentParameters[i];
+                        }
+
+                        if (energyDebug && foundBestEnergy)
+                            std::cout << "lower energy found: " << bestEnergy << std::endl;
+
+                        if (foundBestEnergy)
+                            improvementCallback.notify(bestParameters.data());
+                    }
+
+                    switch (coolingSchedule)
+                    {
+                    case COOLING_LUNDY_MEES:
+                        temp = temp / (1.0 + ((temperatureDivider - 1.0) / temperatureStart) * temp);
+                        break;
+                    case COOLING_ADAPTIVE_ACCEPTANCE:
+                    {
+                        const double acceptanceRatio = numAccepted / (double)NumObjects;
+                        const double minimumDivider = 1.0 + 0.01 * (temperatureDivider - 1.0);
+                        double factor = 1.0;
+                        if (acceptanceRatio > targetAcceptanceRatio)
+                            factor = std::pow(temperatureDivider, (acceptanceRatio - targetAcceptanceRatio) / (1.0 - targetAcceptanceRatio));
+                        else
+                            factor = std::pow(temperatureDivider, (acceptanceRatio - targetAcceptanceRatio) / targetAcceptanceRatio);
+
+                        // at most ln(temperatureStart / temperatureStop) / ln(minimumDivider) iterations per reheat
+                        temp *= std::min(factor, 1.0 / minimumDivider);
+                        break;
+                    }
+                    default:
+                        temp /= temperatureDivider;
+                        break;
+                    }
+
+                    if (!(temp > temperatureStop))
+                    {
+                        if (polishRounds > 0)
+                        {
+                            std::vector<ParameterType> polished(NumParameters);
+                            const ParameterType polishedEnergy = refineCandidates(temperatureStop, polished);
+                            if (debug)
+                                std::cout << "local refinement energy=" << polishedEnergy << std::endl;
+                            if (polishedEnergy < foundEnergy)
+                            {
+                                foundEnergy = polishedEnergy;
+                                for (int i = 0; i < NumParameters; i++)
+                                {
+                                    currentParameters[i] = polished[i];
+                                    parameterIn.access<ParameterType>(i) = polished[i];
+                                }
+
+                                if (bestEnergy > polishedEnergy)
+                                {
+                                    bestEnergy = polishedEnergy;
+                                    bestParameters = polished;
+                                    if (energyDebug)
+                                        std::cout << "lower energy found: " << bestEnergy << std::endl;
+                                    improvementCallback.notify(bestParameters.data());
+                                }
+                            }
+                        }
+
+                        reheat--;
+                        if (reheat > 0)
+                        {
+                            if (debug || energyDebug)
+                                std::cout << "reheating. num reheats left=" << reheat << std::endl;
+
+                            temp = temperatureStart;
+                            iter = 0;
+                        }
+                    }
+
+                    // state and temperature of next iteration are known (loop ends when there are no reheats left)
+                    if (temp > temperatureStop)
+                        recordRunState(temp, reheat, foundEnergy, bestEnergy);
+
+                    if (trace.enabled())
+                    {
+                        TraceEvent& event = nextTraceEvent();
+                        event.iteration = iterationsDone;
+                        event.reheatsLeft = launchReheatsLeft;
+                        event.temperature = launchTemperature;
+                        event.currentEnergy = foundEnergy;
+                        event.bestEnergy = bestEnergy;
+                        event.acceptanceRatio = (coolingSchedule != COOLING_REHEAT_ON_IMPROVEMENT) ? numAccepted / (double)NumObjects : -1;
+                        event.iterationNanoSeconds = measuredNanoSec;
+                    }
+                    if (convergenceTracing)
+                    {
+                        // energies are on host already (copied for selection), so distribution is computed here instead of an extra reduction kernel
+                        const size_t middle = NumObjects / 2;
+                        std::nth_element(populationEnergies.begin(), populationEnergies.begin() + middle, populationEnergies.end());
+                        double median = populationEnergies[middle];
+                        if (NumObjects % 2 == 0)
+                            median = 0.5 * (median + *std::max_element(populationEnergies.begin(), populationEnergies.begin() + middle));
+                        convergence.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count());
+                        convergence.iteration.push_back(iterationsDone);
+                        convergence.temperature.push_back(launchTemperature);
+                        convergence.bestEnergy.push_back(bestEnergy);
+                        convergence.populationMin.push_back(*std::min_element(populationEnergies.begin(), populationEnergies.end()));
+                        convergence.populationMedian.push_back(median);
+                        convergence.populationMax.push_back(*std::max_element(populationEnergies.begin(), populationEnergies.end()));
+                    }
+                    iterationsDone++;
+                    if (debug)
+                        std::cout << "computation-time=" << measuredNanoSec * 0.000000001 << " seconds" << std::endl;
+                    if (debug && coolingSchedule != COOLING_REHEAT_ON_IMPROVEMENT)
+                        std::cout << "temperature=" << launchTemperature << " acceptance-ratio=" << numAccepted / (double)NumObjects << std::endl;
+
+                    if (bestEnergy <= stopEnergy || std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count() > maxRunSeconds)
+                    {
+                        if (debug || energyDebug)
+                            std::cout << "run limit reached" << std::endl;
+                        break;
+                    }
+                }
+                recordRunState(temp, reheat, foundEnergy, bestEnergy);
+            }
+            if (debug || energyDebug)
+                std::cout << "total computation-time=" << measuredNanoSecTot * 0.000000001 << " seconds (this includes debugging console-output that is slow)" << std::endl;
+
+            if (deviceDebug || energyDebug)
+            {
+                std::cout << "---------------" << std::endl;
+                std::cout << "OpenCL device info:" << std::endl;
+                auto names = computer.deviceNames(false);
+                for (int i = 0; i < names.size(); i++)
+                {
+                    std::cout << names[i] << " computed " << (perf[i] * 100.0) << "% of total work" << std::endl;
+                }
+                std::cout << "---------------" << std::endl;
+            }
+
+            // all improved solutions are delivered before returning
+            const size_t droppedSolutions = improvementCallback.finish();
+            if (energyDebug && droppedSolutions > 0)
+                std::cout << droppedSolutions << " intermediate solutions were not sent to callback (callback was slower than improvements)" << std::endl;
+            return bestParameters;
+        }
+    };
+
+    // population annealing: NumObjects replicas are annealed together, each temperature step does Metropolis sweeps per replica (one work-group per replica)
+    // then replicas are resampled proportional to their Boltzmann weights exp(-(beta' - beta) * (E - minimum E of step)) before the next temperature step
+    // resampling is systematic (single random offset for all replicas): ancestors are selected on host with cumulative weights in double precision and each work-group copies its ancestor's parameters at the start of next kernel launch
+    // replicas are load-balanced between devices and an ancestor can be on any device, so population passes through RAM between steps (compact, NumParameters values per replica)
+    // also estimates log-partition-function ratios (free energy differences) between temperature steps
+    // uses same user-code (energy function, helper functions, user inputs) as UltraFastSimulatedAnnealing
+    // NumObjects = number of replicas
+    template<int NumParameters, int NumObjects, typename ParameterType = float>
+    struct PopulationAnnealing : public SolverBase
+    {
+    private:
+        GPGPU::HostParameter settingsIn;
+        GPGPU::HostParameter ancestorIn;
+        GPGPU::HostParameter populationEnergyIn;
+        GPGPU::HostParameter populationIn;
+        GPGPU::HostParameter energyOut;
+        GPGPU::HostParameter populationOut;
+        std::vector<ParameterType> bestParameters;
+        std::vector<double> logPartitionFunctionRatios;
+    public:
+        PopulationAnnealing(std::string funcToMinimize, int gpuThreadsPerObject = 256, int numGPUsToUse = 16, int deviceSelection = GPGPU::Computer::DEVICE_ALL) :SolverBase(funcToMinimize, NumParameters, NumObjects, gpuThreadsPerObject, numGPUsToUse, deviceSelection)
+        {
+            bestParameters.resize(NumParameters);
+        }
+
+        void build()
+        {
+            buildConstants<ParameterType>();
+
+            // energy is computed in the sweep loop, local arrays of user code are declared before it
+            const std::pair<std::string, std::string> energyCode = splitKernelScopeDeclarations(funcMin);
+
+            kernel = constants + helperFunctions() + std::string(R"(
+
+            kernel void populationAnnealingKernel(global unsigned int * randomCounterIn, global GPGPU_REAL_VAL * settingsIn, global int * ancestorIn, global GPGPU_REAL_VAL * populationEnergyIn, global GPGPU_REAL_VAL * populationIn, global GPGPU_REAL_VAL * energyOut, global GPGPU_REAL_VAL * populationOut )") + mutationArguments() + userInputs + std::string(R"()
+            {
+                const GPGPU_INDEX id = get_global_id(0);
+                const int groupId = id / WorkGroupThreads;
+                const int localId = id % WorkGroupThreads;
+                local GPGPU_REAL_VAL parameters[NumParameters];
+                local GPGPU_REAL_VAL replica[NumParameters];
+                local GPGPU_REAL_VAL energies[WorkGroupThreads];
+                local int accepted;
+                local GPGPU_REAL_VAL earlyExitEnergy[WorkGroupThreads];
+                )") + energyCode.first + std::string(R"(
+                const GPGPU_REAL_VAL gpgpuHalf = 0.5;
+                const GPGPU_REAL_VAL beta = settingsIn[0];
+                const int resample = settingsIn[1] > gpgpuHalf;
+                const int evaluateReplica = settingsIn[2] > gpgpuHalf;
+                const int numSweeps = (int)(settingsIn[3] + gpgpuHalf);
+                const GPGPU_REAL_VAL stepSize = settingsIn[4];
+                const int numLoopIter = (NumParameters / WorkGroupThreads) + 1;
+                const unsigned int iteration = randomCounterIn[0];
+                const unsigned int randomKey = randomCounterIn[1];
+
+                // resampled replica starts from its ancestor (selected by host)
+                const int ancestor = resample ? ancestorIn[groupId] : groupId;
+                for(int i=0;i<numLoopIter;i++)
+                {
+                    const int loopId = localId + WorkGroupThreads * i;
+                    if(loopId < NumParameters)
+                    {
+                        replica[loopId] = populationIn[loopId + (GPGPU_INDEX)ancestor*NumParameters];
+                        parameters[loopId] = replica[loopId];
+                    }
+                }
+                GPGPU_REAL_VAL replicaEnergy = populationEnergyIn[ancestor];
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                const int threadId = localId;
+                const int objectId = groupId;
+                const int fidelityStride = 1;
+                const int fidelityOffset = 0;
+
+                // first sweep only computes energy of replica when it is not known yet (first temperature step)
+                for(int sweep = (evaluateReplica ? -1 : 0); sweep < numSweeps; sweep++)
+                {
+                    if(sweep >= 0)
+                    {
+                        for(int i=0;i<numLoopIter;i++)
+                        {
+                            const int loopId = localId + WorkGroupThreads * i;
+                            if(loopId < NumParameters)
+                            {
+                                const Philox4x32 randomValues = philox(groupId, loopId, iteration, sweep, randomKey, 0);
+                                GPGPU_REAL_VAL change = mutationStep(randomValues.x, randomValues.y)*stepSize;
+#if UseParameterStepScales
+                                change *= stepScaleIn[loopId];
+#endif
+
+                                parameters[loopId] = wrapNormalized(replica[loopId], change);
+                            }
+                        }
+                        barrier(CLK_LOCAL_MEM_FENCE);
+                    }
+
+                    // Metropolis acceptance (random < exp(-beta * (E - replicaEnergy))) as an energy threshold, known before energy is computed
+                    // stream after the parameter streams
+                    const Philox4x32 acceptanceRandom = philox(groupId, NumParameters, iteration, sweep, randomKey, 0);
+                    const GPGPU_REAL_VAL energyBound = (sweep < 0) ? (GPGPU_REAL_VAL)INFINITY : replicaEnergy - log(random(acceptanceRandom.x)+(GPGPU_REAL_VAL)0.000000001) / beta;
+
+                    // objective function by user
+                    {
+                        GPGPU_REAL_VAL energy = GPGPU_ZERO_REAL_VAL;
+                        )") + energyCode.second + std::string(R"(
+                        energies[localId] = energy;
+                    }
+                    // objective function end
+
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                    for(unsigned int i=WorkGroupThreads/2;i>=1;i>>=1)
+                    {
+                        unsigned int reduceId = i + localId;
+                        if(localId<i)
+                            energies[localId] += energies[reduceId]; 
+                        barrier(CLK_LOCAL_MEM_FENCE);
+                    }
+
+                    // Metropolis acceptance at current temperature
+                    if(localId == 0)
+                    {
+                        accepted = (sweep < 0) || (energies[0] <= replicaEnergy) || (energies[0] <= energyBound);
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                    if(accepted)
+                    {
+                        replicaEnergy = energies[0];
+                        for(int i=0;i<numLoopIter;i++)
+                        {
+                            const int loopId = localId + WorkGroupThreads * i;
+                            if(loopId < NumParameters)
+                            {
+                                replica[loopId] = parameters[loopId];
+                            }
+                        }
+                    }
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+
+                // Boltzmann weights for the next temperature are computed by host, relative to lowest energy of all replicas
+                if(localId == 0)
+                    energyOut[id] = replicaEnergy;
+
+                for(int i=0;i<numLoopIter;i++)
+                {
+                    const int loopId = localId + WorkGroupThreads * i;
+                    const GPGPU_INDEX arrayId = loopId + (GPGPU_INDEX)groupId*WorkGroupThreads*NumParamsPerThread;
+                    if(loopId < NumParameters)
+                    {
+                        populationOut[arrayId] = replica[loopId];
+                    }
+                }
+            }
+        )");
+
+            computer.compile(kernel, "populationAnnealingKernel");
+            createMutationInputs<ParameterType>();
+            createRandomInputs();
+            settingsIn = computer.createArrayInput<ParameterType>("settingsIn", 5);
+            ancestorIn = computer.createArrayInput<int>("ancestorIn", NumObjects);
+            populationEnergyIn = computer.createArrayInput<ParameterType>("populationEnergyIn", NumObjects);
+            populationIn = computer.createArrayInput<ParameterType>("populationIn", (size_t)NumObjects * NumParameters);
+            energyOut = computer.createArrayOutput<ParameterType>("energyOut", numWorkGroupsToRun * workGroupThreads);
+            populationOut = computer.createArrayOutput<ParameterType>("populationOut",
+                numWorkGroupsToRun * numParametersItersPerWorkgroupWithUnused * workGroupThreads, numParametersItersPerWorkgroupWithUnused);
+        }
+
+        // element k = ln(Z(beta_k) / Z(beta_0)) where beta_k = 1 / temperature of k-th step of last run
+        // free energy difference between step k and first step is -element / beta_k
+        std::vector<double> getLogPartitionFunctionRatios()
+        {
+            return logPartitionFunctionRatios;
+        }
+
+        // temperature goes geometrically from temperatureStart to temperatureStop in numTemperatureSteps steps
+        // step size of mutations is stepSizeStart at temperatureStart and shrinks linearly with temperature
+        std::vector<ParameterType> run(
+            const ParameterType temperatureStart = 1.0f, const ParameterType temperatureStop = 0.01f, const int numTemperatureSteps = 100,
+            const int sweepsPerTemperature = 5, const ParameterType stepSizeStart = 0.1f,
+            const bool debug = false, const bool deviceDebug = false, const bool energyDebug = false,
+            std::function<void(ParameterType*)> callbackLowerEnergyFound = [](ParameterType*) {},
+            std::vector<ParameterType> userHintsForInitialParametersNormalized = std::vector<ParameterType>()
+        )
+        {
+            std::mt19937 rng = hostRandomEngine();
+            std::uniform_real_distribution<float> uid(0.0f, 1.0f);
+            CallbackDispatcher<ParameterType> improvementCallback(callbackLowerEnergyFound, NumParameters, callbackQueueCapacity);
+
+            auto kernelParams = bindUserInputs(bindMutationInputs(randomCounterIn.next(settingsIn).next(ancestorIn).next(populationEnergyIn).next(populationIn).next(energyOut).next(populationOut)));
+
+            // initial replicas are uniformly distributed, first M replicas are M user hints (concatenated hint vectors), if given
+            const size_t slab = numParametersItersPerWorkgroupWithUnused * workGroupThreads;
+            for (int i = 0; i < NumObjects; i++)
+                for (int j = 0; j < NumParameters; j++)
+                    populationIn.access<ParameterType>(j + (size_t)i * NumParameters) = uid(rng);
+            const int numHints = std::min((int)(userHintsForInitialParametersNormalized.size() / NumParameters), NumObjects);
+            for (int i = 0; i < numHints; i++)
+                for (int j = 0; j < NumParameters; j++)
+                    populationIn.access<ParameterType>(j + (size_t)i * NumParameters) = userHintsForInitialParametersNormalized[j + i * NumParameters];
+
+            logPartitionFunctionRatios.clear();
+            double logPartitionFunctionRatio = 0.0;
+            std::vector<double> cumulativeWeights(NumObjects);
+            ParameterType bestEnergy = std::numeric_limits<ParameterType>::max();
+            std::vector<double> perf;
+            size_t measuredNanoSecTot = 0;
+            {
+                GPGPU::Bench benchTot(&measuredNanoSecTot);
+                for (int step = 0; step < numTemperatureSteps; step++)
+                {
+                    const double ratio = (numTemperatureSteps > 1) ? (step / (double)(numTemperatureSteps - 1)) : 1.0;
+                    const double temp = temperatureStart * std::pow(temperatureStop / (double)temperatureStart, ratio);
+                    const double tempNext = (step + 1 < numTemperatureSteps) ? (temperatureStart * std::pow(temperatureStop / (double)temperatureStart, (step + 1) / (double)(numTemperatureSteps - 1))) : temp;
+
+                    settingsIn.access<ParameterType>(0) = 1.0 / temp;
+                    settingsIn.access<ParameterType>(1) = (step > 0) ? 1 : 0;
+                    settingsIn.access<ParameterType>(2) = (step == 0) ? 1 : 0;
+                    settingsIn.access<ParameterType>(3) = sweepsPerTemperature;
+                    settingsIn.access<ParameterType>(4) = stepSizeStart * (temp / temperatureStart);
+
+                    size_t measuredNanoSec = 0;
+                    int foundIdBest = -1;
+                    double totalWeight = 0.0;
+                    ParameterType minEnergy = std::numeric_limits<ParameterType>::max();
+                    const double deltaBeta = 1.0 / tempNext - 1.0 / temp;
+                    {
+                        GPGPU::Bench bench(&measuredNanoSec);
+                        advanceRandomCounter();
+                        perf = computer.compute(kernelParams, "populationAnnealingKernel", 0, numWorkGroupsToRun * workGroupThreads, workGroupThreads);
+
+                        for (int i = 0; i < NumObjects; i++)
+                        {
+                            const ParameterType energy = energyOut.access<ParameterType>((size_t)i * workGroupThreads);
+                            populationEnergyIn.access<ParameterType>(i) = energy;
+                            if (minEnergy > energy)
+                            {
+                                minEnergy = energy;
+                                if (bestEnergy > energy)
+                                {
+                                    bestEnergy = energy;
+                                    foundIdBest = i;
+                                }
+                            }
+                        }
+
+                        // cumulative weights relative to lowest energy of this step so that weights are in (0,1] and their sum is at least 1
+                        // kept in double so that small weights are not lost in large sums of many replicas
+                        for (int i = 0; i < NumObjects; i++)
+                        {
+                            totalWeight += std::exp(-deltaBeta * ((double)populationEnergyIn.access<ParameterType>(i) - minEnergy));
+                            cumulativeWeights[i] = totalWeight;
+                        }
+
+                        // systematic resampling for next launch: ancestor of replica i is the replica whose cumulative-weight interval contains (i + offset) / NumObjects
+                        // targets are increasing so a single pass over cumulative weights finds all ancestors
+                        const double resampleOffset = uid(rng);
+                        int ancestor = 0;
+                        for (int i = 0; i < NumObjects; i++)
+                        {
+                            const double target = ((i + resampleOffset) / NumObjects) * totalWeight;
+                            while (ancestor < NumObjects - 1 && cumulativeWeights[ancestor] <= target)
+                                ancestor++;
+                            ancestorIn.access<int>(i) = ancestor;
+                        }
+
+                        // only parameters are copied for next launch (output has padding of work-group threads per replica)
+                        for (int i = 0; i < NumObjects; i++)
+                            std::copy(populationOut.accessPtr<ParameterType>(i * slab), populationOut.accessPtr<ParameterType>(i * slab) + NumParameters, populationIn.accessPtr<ParameterType>((size_t)i * NumParameters));
+                    }
+
+                    // ln(Z(beta') / Z(beta)) = ln(mean(weight)) - (beta' - beta) * reference energy
+                    logPartitionFunctionRatios.push_back(logPartitionFunctionRatio);
+                    logPartitionFunctionRatio += std::log(totalWeight / NumObjects) - deltaBeta * minEnergy;
+
+                    if (debug)
+                        std::cout << "step-" << step << " temperature=" << temp << " computation-time=" << measuredNanoSec * 0.000000001 << " seconds" << std::endl;
+
+                    if (foundIdBest >= 0)
+                    {
                         for (int i = 0; i < NumParameters; i++)
                         {
-                            parameterIn.access<ParameterType>(i) = currentParameters[i];
+                            bestParameters[i] = populationOut.access<ParameterType>(i + foundIdBest * slab);
                         }
 
-                        if (energyDebug && foundBestEnergy)
+                        if (energyDebug)
                             std::cout << "lower energy found: " << bestEnergy << std::endl;
 
-                        if (foundBestEnergy)
-                            callbackLowerEnergyFound(bestParameters.data());
+                        improvementCallback.notify(bestParameters.data());
                     }
+                }
+            }
+            if (debug || energyDebug)
+                std::cout << "total computation-time=" << measuredNanoSecTot * 0.000000001 << " seconds (this includes debugging console-output that is slow)" << std::endl;
+
+            if (deviceDebug || energyDebug)
+            {
+                std::cout << "---------------" << std::endl;
+                std::cout << "OpenCL device info:" << std::endl;
+                auto names = computer.deviceNames(false);
+                for (int i = 0; i < names.size(); i++)
+                {
+                    std::cout << names[i] << " computed " << (perf[i] * 100.0) << "% of total work" << std::endl;
+                }
+                std::cout << "---------------" << std::endl;
+            }
 
-                    temp /= temperatureDivider;
-                    temperatureIn.access<ParameterType>(0) = temp;
+            // all improved solutions are delivered before returning
+            const size_t droppedSolutions = improvementCallback.finish();
+            if (energyDebug && droppedSolutions > 0)
+                std::cout << droppedSolutions << " intermediate solutions were not sent to callback (callback was slower than improvements)" << std::endl;
+            return bestParameters;
+        }
+    };
 
-                    if (!(temp > temperatureStop))
+    // differential evolution (DE/rand/1/bin): each object is a population member (one work-group per member)
+    // mutation, crossover and selection are fused into the energy evaluation kernel: work-group picks 3 random members, builds trial vector, computes its energy and keeps the better one of trial and current member
+    // members are load-balanced between devices and donors can be on any device, so population passes through RAM between generations (compact, NumParameters values per member)
+    // uses same user-code (energy function, helper functions, user inputs) as UltraFastSimulatedAnnealing
+    // NumObjects = population size (minimum 4)
+    template<int NumParameters, int NumObjects, typename ParameterType = float>
+    struct DifferentialEvolution : public SolverBase
+    {
+    private:
+        GPGPU::HostParameter settingsIn;
+        GPGPU::HostParameter populationEnergyIn;
+        GPGPU::HostParameter populationIn;
+        GPGPU::HostParameter energyOut;
+        GPGPU::HostParameter populationOut;
+        std::vector<ParameterType> bestParameters;
+    public:
+        DifferentialEvolution(std::string funcToMinimize, int gpuThreadsPerObject = 256, int numGPUsToUse = 16, int deviceSelection = GPGPU::Computer::DEVICE_ALL) :SolverBase(funcToMinimize, NumParameters, NumObjects, gpuThreadsPerObject, numGPUsToUse, deviceSelection)
+        {
+            static_assert(NumObjects >= 4, "differential evolution requires at least 4 objects");
+            bestParameters.resize(NumParameters);
+        }
+
+        void build()
+        {
+            buildConstants<ParameterType>();
+
+            kernel = constants + helperFunctions() + std::string(R"(
+
+            kernel void differentialEvolutionKernel(global unsigned int * randomCounterIn, global GPGPU_REAL_VAL * settingsIn, global GPGPU_REAL_VAL * populationEnergyIn, global GPGPU_REAL_VAL * populationIn, global GPGPU_REAL_VAL * energyOut, global GPGPU_REAL_VAL * populationOut )") + userInputs + std::string(R"()
+            {
+                const GPGPU_INDEX id = get_global_id(0);
+                const int groupId = id / WorkGroupThreads;
+                const int localId = id % WorkGroupThreads;
+                local GPGPU_REAL_VAL parameters[NumParameters];
+                local GPGPU_REAL_VAL energies[WorkGroupThreads];
+                local int donors[4];
+                local GPGPU_REAL_VAL earlyExitEnergy[WorkGroupThreads];
+                const GPGPU_REAL_VAL gpgpuHalf = 0.5;
+                const GPGPU_REAL_VAL differentialWeight = settingsIn[0];
+                const GPGPU_REAL_VAL crossoverProbability = settingsIn[1];
+                const int evaluateOnly = settingsIn[2] > gpgpuHalf;
+
+                // trial vector does not replace current member with a higher energy
+                const GPGPU_REAL_VAL energyBound = evaluateOnly ? (GPGPU_REAL_VAL)INFINITY : populationEnergyIn[groupId];
+                const int numLoopIter = (NumParameters / WorkGroupThreads) + 1;
+                const GPGPU_INDEX slab = WorkGroupThreads*NumParamsPerThread;
+                const unsigned int iteration = randomCounterIn[0];
+                const unsigned int randomKey = randomCounterIn[1];
+
+                // 3 distinct donors that are different than current member + 1 parameter that is always crossed over
+                // (stream after the parameter streams, each rejected attempt uses next sub-step of counter)
+                if(localId == 0)
+                {
+                    unsigned int attempt = 0;
+                    Philox4x32 randomValues = philox(groupId, NumParameters, iteration, attempt, randomKey, 0);
+                    int r0 = randomValues.x % NumObjects;
+                    while(r0 == groupId)
                     {
-                        reheat--;
-                        if (reheat == 0)
+                        randomValues = philox(groupId, NumParameters, iteration, ++attempt, randomKey, 0);
+                        r0 = randomValues.x % NumObjects;
+                    }
+                    int r1 = randomValues.y % NumObjects;
+                    while(r1 == groupId || r1 == r0)
+                    {
+                        randomValues = philox(groupId, NumParameters, iteration, ++attempt, randomKey, 0);
+                        r1 = randomValues.y % NumObjects;
+                    }
+                    int r2 = randomValues.z % NumObjects;
+                    while(r2 == groupId || r2 == r0 || r2 == r1)
+                    {
+                        randomValues = philox(groupId, NumParameters, iteration, ++attempt, randomKey, 0);
+                        r2 = randomValues.z % NumObjects;
+                    }
+                    donors[0] = r0;
+                    donors[1] = r1;
+                    donors[2] = r2;
+                    donors[3] = randomValues.w % NumParameters;
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                // mutation + crossover
+                for(int i=0;i<numLoopIter;i++)
+                {
+                    const int loopId = localId + WorkGroupThreads * i;
+                    if(loopId < NumParameters)
+                    {
+                        const GPGPU_REAL_VAL current = populationIn[loopId + (GPGPU_INDEX)groupId*NumParameters];
+                        const Philox4x32 randomValues = philox(groupId, loopId, iteration, 0, randomKey, 0);
+                        if(!evaluateOnly && (loopId == donors[3] || random(randomValues.x) < crossoverProbability))
                         {
-                            break;
+                            const GPGPU_REAL_VAL mutant = populationIn[loopId + (GPGPU_INDEX)donors[0]*NumParameters] + differentialWeight * (populationIn[loopId + (GPGPU_INDEX)donors[1]*NumParameters] - populationIn[loopId + (GPGPU_INDEX)donors[2]*NumParameters]);
+
+                            // out-of-range values are bounced back between current value and the exceeded bound
+                            if(mutant < GPGPU_ZERO_REAL_VAL)
+                                parameters[loopId] = current * gpgpuHalf;
+                            else if(mutant > (GPGPU_REAL_VAL)1.0)
+                                parameters[loopId] = (current + (GPGPU_REAL_VAL)1.0) * gpgpuHalf;
+                            else
+                                parameters[loopId] = mutant;
                         }
                         else
+                            parameters[loopId] = current;
+                    }
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                // objective function by user                
+                GPGPU_REAL_VAL energy = GPGPU_ZERO_REAL_VAL;
+                const int threadId = localId;
+                const int objectId = groupId;
+                const int fidelityStride = 1;
+                const int fidelityOffset = 0;
+                )") + funcMin + std::string(R"(
+                energies[localId] = energy;
+                // objective function end
+
+                barrier(CLK_LOCAL_MEM_FENCE);
+                for(unsigned int i=WorkGroupThreads/2;i>=1;i>>=1)
+                {
+                    unsigned int reduceId = i + localId;
+                    if(localId<i)
+                        energies[localId] += energies[reduceId]; 
+                    barrier(CLK_LOCAL_MEM_FENCE);
+                }
+
+                // selection
+                const int trialWins = evaluateOnly || (energies[0] <= populationEnergyIn[groupId]);
+                if(localId == 0)
+                    energyOut[id] = trialWins ? energies[0] : populationEnergyIn[groupId];
+
+                for(int i=0;i<numLoopIter;i++)
+                {
+                    const int loopId = localId + WorkGroupThreads * i;
+                    const GPGPU_INDEX arrayId = loopId + groupId*slab;
+                    if(loopId < NumParameters)
+                    {
+                        populationOut[arrayId] = trialWins ? parameters[loopId] : populationIn[loopId + (GPGPU_INDEX)groupId*NumParameters];
+                    }
+                }
+            }
+        )");
+
+            computer.compile(kernel, "differentialEvolutionKernel");
+            createRandomInputs();
+            settingsIn = computer.createArrayInput<ParameterType>("settingsIn", 3);
+            populationEnergyIn = computer.createArrayInput<ParameterType>("populationEnergyIn", NumObjects);
+            populationIn = computer.createArrayInput<ParameterType>("populationIn", (size_t)NumObjects * NumParameters);
+            energyOut = computer.createArrayOutput<ParameterType>("energyOut", numWorkGroupsToRun * workGroupThreads);
+            populationOut = computer.createArrayOutput<ParameterType>("populationOut",
+                numWorkGroupsToRun * numParametersItersPerWorkgroupWithUnused * workGroupThreads, numParametersItersPerWorkgroupWithUnused);
+        }
+
+        // differentialWeight = F (generally between 0.4 and 1.0), crossoverProbability = CR (generally 0.9 for correlated parameters, 0.1 for separable problems)
+        // population is initialized uniformly in (0,1) range, optionally including user hints (1 or M concatenated hint vectors) as first members
+        std::vector<ParameterType> run(
+            const int numGenerations = 1000, const ParameterType differentialWeight = 0.5f, const ParameterType crossoverProbability = 0.9f,
+            const bool debug = false, const bool deviceDebug = false, const bool energyDebug = false,
+            std::function<void(ParameterType*)> callbackLowerEnergyFound = [](ParameterType*) {},
+            std::vector<ParameterType> userHintForInitialParametersNormalized = std::vector<ParameterType>()
+        )
+        {
+            std::mt19937 rng = hostRandomEngine();
+            std::uniform_real_distribution<float> uid(0.0f, 1.0f);
+            CallbackDispatcher<ParameterType> improvementCallback(callbackLowerEnergyFound, NumParameters, callbackQueueCapacity);
+
+            auto kernelParams = bindUserInputs(randomCounterIn.next(settingsIn).next(populationEnergyIn).next(populationIn).next(energyOut).next(populationOut));
+
+            const size_t slab = numParametersItersPerWorkgroupWithUnused * workGroupThreads;
+            for (int i = 0; i < NumObjects; i++)
+                for (int j = 0; j < NumParameters; j++)
+                    populationIn.access<ParameterType>(j + (size_t)i * NumParameters) = uid(rng);
+
+            const int numHints = std::min((int)(userHintForInitialParametersNormalized.size() / NumParameters), NumObjects);
+            for (int i = 0; i < numHints; i++)
+                for (int j = 0; j < NumParameters; j++)
+                    populationIn.access<ParameterType>(j + (size_t)i * NumParameters) = userHintForInitialParametersNormalized[j + i * NumParameters];
+
+            settingsIn.access<ParameterType>(0) = differentialWeight;
+            settingsIn.access<ParameterType>(1) = crossoverProbability;
+
+            ParameterType bestEnergy = std::numeric_limits<ParameterType>::max();
+            std::vector<double> perf;
+            size_t measuredNanoSecTot = 0;
+            {
+                GPGPU::Bench benchTot(&measuredNanoSecTot);
+
+                // first launch only computes energies of initial population
+                for (int generation = -1; generation < numGenerations; generation++)
+                {
+                    settingsIn.access<ParameterType>(2) = (generation < 0) ? 1 : 0;
+
+                    size_t measuredNanoSec = 0;
+                    int foundIdBest = -1;
+                    {
+                        GPGPU::Bench bench(&measuredNanoSec);
+                        advanceRandomCounter();
+                        perf = computer.compute(kernelParams, "differentialEvolutionKernel", 0, numWorkGroupsToRun * workGroupThreads, workGroupThreads);
+
+                        for (int i = 0; i < NumObjects; i++)
                         {
-                            if (debug || energyDebug)
-                                std::cout << "reheating. num reheats left=" << reheat << std::endl;
+                            const ParameterType energy = energyOut.access<ParameterType>(i * workGroupThreads);
+                            populationEnergyIn.access<ParameterType>(i) = energy;
+                            if (bestEnergy > energy)
+                            {
+                                bestEnergy = energy;
+                                foundIdBest = i;
+                            }
+                        }
 
-                            temp = temperatureStart;
-                            iter = 0;
+                        // only parameters are copied for next generation (output has padding of work-group threads per member)
+                        for (int i = 0; i < NumObjects; i++)
+                            std::copy(populationOut.accessPtr<ParameterType>(i * slab), populationOut.accessPtr<ParameterType>(i * slab) + NumParameters, populationIn.accessPtr<ParameterType>((size_t)i * NumParameters));
+                    }
+
+                    if (debug)
+                        std::cout << "generation-" << generation << " computation-time=" << measuredNanoSec * 0.000000001 << " seconds" << std::endl;
+
+                    if (foundIdBest >= 0)
+                    {
+                        for (int i = 0; i < NumParameters; i++)
+                        {
+                            bestParameters[i] = populationOut.access<ParameterType>(i + foundIdBest * slab);
                         }
+
+                        if (energyDebug)
+                            std::cout << "lower energy found: " << bestEnergy << std::endl;
+
+                        improvementCallback.notify(bestParameters.data());
                     }
                 }
             }
@@ -513,7 +3271,262 @@ namespace UFSACL
                 }
                 std::cout << "---------------" << std::endl;
             }
+
+            // all improved solutions are delivered before returning
+            const size_t droppedSolutions = improvementCallback.finish();
+            if (energyDebug && droppedSolutions > 0)
+                std::cout << droppedSolutions << " intermediate solutions were not sent to callback (callback was slower than improvements)" << std::endl;
             return bestParameters;
         }
     };
-}
\ No newline at end of file
+
+    // settings of UltraFastSimulatedAnnealing found by Autotuner, can be saved to a file and loaded in later runs of same kind of problem
+    // usage: UltraFastSimulatedAnnealing<P, N> sim(energyCode, cfg.gpuThreadsPerObject); ... sim.run(cfg.temperatureStart, cfg.temperatureStop, cfg.temperatureDivider, cfg.numReheats);
+    struct AnnealingConfiguration
+    {
+        double temperatureStart;
+        double temperatureStop;
+        double temperatureDivider;
+        int numReheats;
+        int gpuThreadsPerObject;
+        // NumObjects of the tuned solver (informative, it is a template parameter)
+        int numObjects;
+        // median seconds to reach target energy over trials (infinity if most trials did not reach it)
+        double timeToTarget;
+        // ratio of trials that reached target energy
+        double successRatio;
+        // median of lowest energies of trials
+        double finalEnergy;
+
+        AnnealingConfiguration() :temperatureStart(1.0), temperatureStop(0.01), temperatureDivider(2.0), numReheats(5), gpuThreadsPerObject(256), numObjects(0),
+            timeToTarget(std::numeric_limits<double>::infinity()), successRatio(0), finalEnergy(std::numeric_limits<double>::infinity())
+        {
+        }
+
+        // "key value" lines
+        void save(std::string path) const
+        {
+            std::ofstream file(path, std::ios::trunc);
+            if (!file)
+                throw std::invalid_argument(std::string("Error: could not open configuration file ") + path);
+            file.precision(17);
+            file << "temperatureStart " << temperatureStart << "\n";
+            file << "temperatureStop " << temperatureStop << "\n";
+            file << "temperatureDivider " << temperatureDivider << "\n";
+            file << "numReheats " << numReheats << "\n";
+            file << "gpuThreadsPerObject " << gpuThreadsPerObject << "\n";
+            file << "numObjects " << numObjects << "\n";
+            file << "timeToTarget " << timeToTarget << "\n";
+            file << "successRatio " << successRatio << "\n";
+            file << "finalEnergy " << finalEnergy << "\n";
+            if (!file)
+                throw std::invalid_argument(std::string("Error: could not write configuration file ") + path);
+        }
+
+        static AnnealingConfiguration load(std::string path)
+        {
+            std::ifstream file(path);
+            if (!file)
+                throw std::invalid_argument(std::string("Error: could not open configuration file ") + path);
+            AnnealingConfiguration configuration;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                std::istringstream fields(line);
+                std::string key;
+                std::string value;
+                if (!(fields >> key >> value))
+                    continue;
+                if (key == "temperatureStart")
+                    configuration.temperatureStart = std::stod(value);
+                else if (key == "temperatureStop")
+                    configuration.temperatureStop = std::stod(value);
+                else if (key == "temperatureDivider")
+                    configuration.temperatureDivider = std::stod(value);
+                else if (key == "numReheats")
+                    configuration.numReheats = std::stoi(value);
+                else if (key == "gpuThreadsPerObject")
+                    configuration.gpuThreadsPerObject = std::stoi(value);
+                else if (key == "numObjects")
+                    configuration.numObjects = std::stoi(value);
+                else if (key == "timeToTarget")
+                    configuration.timeToTarget = std::stod(value);
+                else if (key == "successRatio")
+                    configuration.successRatio = std::stod(value);
+                else if (key == "finalEnergy")
+                    configuration.finalEnergy = std::stod(value);
+            }
+            return configuration;
+        }
+    };
+
+    // values that Autotuner samples for each setting of run() and constructor
+    struct AutotuneSpace
+    {
+        std::vector<double> temperatureStart = { 0.1, 0.3, 1.0, 3.0 };
+        std::vector<double> temperatureStop = { 0.0001, 0.001, 0.01 };
+        std::vector<double> temperatureDivider = { 1.05, 1.1, 1.3, 1.6, 2.0 };
+        std::vector<int> numReheats = { 1, 2, 5, 10 };
+        std::vector<int> gpuThreadsPerObject = { 32, 64, 128, 256 };
+    };
+
+    // searches settings of run() and threads per object for lowest time to reach a target energy on a representative problem
+    // successive halving: numCandidates random configurations run trialsPerRung trials each with a time budget per trial, after each rung best 1/eta of them stay and budget grows eta times
+    // a trial stops when it reaches target energy or its budget, all configurations of a rung are compared on same random seeds and budget
+    // configurations are ranked by ratio of trials that reached target, then median time-to-target, then median lowest energy
+    // a solver is built once per threads-per-object value, setup is called before its build() (to add user inputs and other settings)
+    // NumObjects is a template parameter, tune each candidate NumObjects with its own Autotuner and compare timeToTarget of results
+    template<int NumParameters, int NumObjects, typename ParameterType = float>
+    struct Autotuner
+    {
+    private:
+        typedef UltraFastSimulatedAnnealing<NumParameters, NumObjects, ParameterType> Solver;
+        std::string funcToMinimize;
+        std::function<void(Solver&)> setup;
+        double targetEnergy;
+        int numGPUsToUse;
+        std::map<int, std::unique_ptr<Solver>> solvers;
+
+        struct Candidate
+        {
+            AnnealingConfiguration configuration;
+            std::vector<double> times;
+            std::vector<double> energies;
+        };
+
+        Solver& solverOf(int gpuThreadsPerObject)
+        {
+            auto it = solvers.find(gpuThreadsPerObject);
+            if (it != solvers.end())
+                return *it->second;
+            std::unique_ptr<Solver> solver(new Solver(funcToMinimize, gpuThreadsPerObject, numGPUsToUse));
+            setup(*solver);
+            solver->build();
+            solver->enableConvergenceTrace();
+            Solver& result = *solver;
+            solvers[gpuThreadsPerObject] = std::move(solver);
+            return result;
+        }
+
+        // one anneal that stops at target energy or after budgetSeconds, time-to-target is taken from convergence trace (infinity when target is not reached)
+        void trial(Candidate& candidate, unsigned int seed, double budgetSeconds)
+        {
+            const AnnealingConfiguration& c = candidate.configuration;
+            Solver& solver = solverOf(c.gpuThreadsPerObject);
+            solver.setRandomSeed(seed);
+            solver.setRunLimits((ParameterType)targetEnergy, budgetSeconds);
+            solver.run(c.temperatureStart, c.temperatureStop, c.temperatureDivider, c.numReheats);
+            const ConvergenceTrace trace = solver.getConvergenceTrace();
+            double time = std::numeric_limits<double>::infinity();
+            for (size_t k = 0; k < trace.size(); k++)
+            {
+                if (trace.bestEnergy[k] <= targetEnergy)
+                {
+                    time = trace.seconds[k];
+                    break;
+                }
+            }
+            candidate.times.push_back(time);
+            candidate.energies.push_back(trace.size() > 0 ? trace.bestEnergy.back() : std::numeric_limits<double>::infinity());
+        }
+
+        static double median(std::vector<double> values)
+        {
+            std::sort(values.begin(), values.end());
+            return values[values.size() / 2];
+        }
+
+        static void score(Candidate& candidate)
+        {
+            size_t successes = 0;
+            for (double time : candidate.times)
+                successes += std::isfinite(time) ? 1 : 0;
+            candidate.configuration.successRatio = successes / (double)candidate.times.size();
+            candidate.configuration.timeToTarget = median(candidate.times);
+            candidate.configuration.finalEnergy = median(candidate.energies);
+        }
+
+        static bool better(const Candidate& a, const Candidate& b)
+        {
+            const AnnealingConfiguration& x = a.configuration;
+            const AnnealingConfiguration& y = b.configuration;
+            if (x.successRatio != y.successRatio)
+                return x.successRatio > y.successRatio;
+            if (x.timeToTarget != y.timeToTarget)
+                return x.timeToTarget < y.timeToTarget;
+            return x.finalEnergy < y.finalEnergy;
+        }
+    public:
+        // funcToMinimize: energy code of solver, targetEnergy: energy that counts as solved
+        Autotuner(std::string funcToMinimizePrm, std::function<void(Solver&)> setupPrm, double targetEnergyPrm, int numGPUsToUsePrm = 16) :
+            funcToMinimize(funcToMinimizePrm), setup(setupPrm), targetEnergy(targetEnergyPrm), numGPUsToUse(numGPUsToUsePrm)
+        {
+        }
+
+        // returns best configuration, debug prints ranking of each rung
+        // firstRungSeconds: time budget of a trial in first rung (multiplied by eta in each next rung)
+        AnnealingConfiguration tune(const AutotuneSpace& space = AutotuneSpace(), int numCandidates = 27, int eta = 3, double firstRungSeconds = 0.5, int trialsPerRung = 3, unsigned int seed = 0, bool debug = false)
+        {
+            if (numCandidates < 1 || eta < 2)
+                throw std::invalid_argument("Error: autotuner needs at least 1 candidate and eta >= 2.");
+            if (!(firstRungSeconds > 0) || trialsPerRung < 1)
+                throw std::invalid_argument("Error: autotuner needs a positive trial budget and at least 1 trial per rung.");
+            if (space.temperatureStart.empty() || space.temperatureStop.empty() || space.temperatureDivider.empty() || space.numReheats.empty() || space.gpuThreadsPerObject.empty())
+                throw std::invalid_argument("Error: autotune space needs at least 1 value per setting.");
+            for (double divider : space.temperatureDivider)
+                if (!(divider > 1.0))
+                    throw std::invalid_argument("Error: temperature divider needs to be greater than 1.");
+
+            std::mt19937 rng{ seed };
+            auto pick = [&](size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); };
+            std::vector<Candidate> candidates;
+            for (int i = 0; i < numCandidates; i++)
+            {
+                Candidate candidate;
+                AnnealingConfiguration& c = candidate.configuration;
+                c.temperatureStart = space.temperatureStart[pick(space.temperatureStart.size())];
+                c.temperatureStop = space.temperatureStop[pick(space.temperatureStop.size())];
+                c.temperatureDivider = space.temperatureDivider[pick(space.temperatureDivider.size())];
+                c.numReheats = space.numReheats[pick(space.numReheats.size())];
+                c.gpuThreadsPerObject = space.gpuThreadsPerObject[pick(space.gpuThreadsPerObject.size())];
+                c.numObjects = NumObjects;
+                // start temperature is at least stop temperature (run() would not iterate otherwise)
+                if (c.temperatureStart <= c.temperatureStop)
+                    std::swap(c.temperatureStart, c.temperatureStop);
+                candidates.push_back(candidate);
+            }
+
+            double budgetSeconds = firstRungSeconds;
+            unsigned int rungSeed = seed;
+            while (true)
+            {
+                // trials of previous rungs had smaller budgets so they are not compared with this rung
+                for (auto& candidate : candidates)
+                {
+                    candidate.times.clear();
+                    candidate.energies.clear();
+                    for (int i = 0; i < trialsPerRung; i++)
+                        trial(candidate, rungSeed + i, budgetSeconds);
+                    score(candidate);
+                }
+                std::stable_sort(candidates.begin(), candidates.end(), better);
+                if (debug)
+                {
+                    std::cout << "rung with " << trialsPerRung << " trials of " << budgetSeconds << " seconds per configuration:" << std::endl;
+                    for (auto& candidate : candidates)
+                    {
+                        const AnnealingConfiguration& c = candidate.configuration;
+                        std::cout << "  start=" << c.temperatureStart << " stop=" << c.temperatureStop << " divider=" << c.temperatureDivider << " reheats=" << c.numReheats
+                            << " threads=" << c.gpuThreadsPerObject << " success=" << c.successRatio << " time-to-target=" << c.timeToTarget << " energy=" << c.finalEnergy << std::endl;
+                    }
+                }
+                if (candidates.size() == 1)
+                    break;
+                candidates.resize((candidates.size() + eta - 1) / eta);
+                budgetSeconds *= eta;
+                rungSeed += trialsPerRung;
+            }
+            return candidates[0].configuration;
+        }
+    };
+}
@@ -0,0 +1,386 @@
+#include"UfSaCL.h"
+#include<vector>
+#include<string>
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<chrono>
+#include<random>
+#include<cmath>
+#include<algorithm>
+#include<functional>
+#include<cstdlib>
+#include<cstring>
+// benchmark suite: standard test functions at a few sizes, solved with default-like settings several times each
+// reports time-to-target, iterations per second, bytes copied per iteration and device utilization as json
+// usage: bench [--cpu] [--repeats N] [--output path.json]
+//      --cpu: only CPU devices are used (for example PoCL on machines without a GPU), otherwise all GPUs and CPUs are used
+//      --repeats: number of anneals per problem with different random seeds (default 3)
+//      --output: json is written to file instead of standard output
+
+struct BenchOptions
+{
+    int deviceSelection = GPGPU::Computer::DEVICE_ALL;
+    int repeats = 3;
+    std::string outputPath;
+};
+
+struct BenchResult
+{
+    std::string problem;
+    int size = 0;
+    int numParameters = 0;
+    int numObjects = 0;
+    int threadsPerObject = 0;
+    double targetEnergy = 0;
+    std::vector<double> timesToTarget;
+    std::vector<double> finalEnergies;
+    size_t iterations = 0;
+    double seconds = 0;
+    size_t tracedIterations = 0;
+    double tracedBytes = 0;
+    std::vector<double> deviceNanoSeconds;
+    double iterationNanoSeconds = 0;
+    std::vector<std::string> deviceNames;
+};
+
+static std::string jsonText(const std::string& text)
+{
+    std::string result = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char)c < 32)
+            continue;
+        result += c;
+    }
+    return result + "\"";
+}
+
+// infinity (target not reached) is written as null
+static std::string jsonNumber(double value)
+{
+    if (!std::isfinite(value))
+        return "null";
+    std::ostringstream text;
+    text.precision(9);
+    text << value;
+    return text.str();
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// anneals same problem options.repeats times and accumulates metrics from convergence trace and iteration trace of each run
+template<int NumParameters, int NumObjects>
+BenchResult benchmark(std::string problem, int size, std::string energyCode, std::function<void(UFSACL::UltraFastSimulatedAnnealing<NumParameters, NumObjects>&)> setup,
+    double targetEnergy, float temperatureStart, float temperatureStop, float temperatureDivider, int numReheats, const BenchOptions& options)
+{
+    const int threadsPerObject = 32;
+    UFSACL::UltraFastSimulatedAnnealing<NumParameters, NumObjects> sim(energyCode, threadsPerObject, 16, options.deviceSelection);
+    setup(sim);
+    sim.build();
+    sim.enableConvergenceTrace();
+
+    BenchResult result;
+    result.problem = problem;
+    result.size = size;
+    result.numParameters = NumParameters;
+    result.numObjects = NumObjects;
+    result.threadsPerObject = threadsPerObject;
+    result.targetEnergy = targetEnergy;
+    result.deviceNames = sim.getDeviceNames();
+    result.deviceNanoSeconds.resize(result.deviceNames.size());
+    for (int r = 0; r < options.repeats; r++)
+    {
+        sim.setRandomSeed(1000 + r);
+        sim.enableTrace(65536);
+        const auto start = std::chrono::steady_clock::now();
+        sim.run(temperatureStart, temperatureStop, temperatureDivider, numReheats);
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const UFSACL::ConvergenceTrace convergence = sim.getConvergenceTrace();
+        double timeToTarget = std::numeric_limits<double>::infinity();
+        for (size_t k = 0; k < convergence.size(); k++)
+        {
+            if (convergence.bestEnergy[k] <= targetEnergy)
+            {
+                timeToTarget = convergence.seconds[k];
+                break;
+            }
+        }
+        result.timesToTarget.push_back(timeToTarget);
+        result.finalEnergies.push_back(convergence.size() > 0 ? convergence.bestEnergy.back() : std::numeric_limits<double>::infinity());
+        result.iterations += convergence.size();
+
+        // only the last 65536 iterations of a run are kept in trace, averages are computed over them
+        for (const UFSACL::TraceEvent& event : sim.getTrace())
+        {
+            result.tracedIterations++;
+            result.iterationNanoSeconds += event.iterationNanoSeconds;
+            for (size_t d = 0; d < event.deviceBytes.size() && d < result.deviceNanoSeconds.size(); d++)
+            {
+                result.tracedBytes += (double)event.deviceBytes[d];
+                result.deviceNanoSeconds[d] += event.deviceNanoSeconds[d];
+            }
+        }
+    }
+    return result;
+}
+
+static void writeJson(std::ostream& out, const std::vector<BenchResult>& results, const BenchOptions& options)
+{
+    out << "{\n";
+    out << "  \"deviceSelection\": " << jsonText(options.deviceSelection == GPGPU::Computer::DEVICE_CPUS ? "cpu" : "all") << ",\n";
+    out << "  \"repeats\": " << options.repeats << ",\n";
+    out << "  \"devices\": [";
+    if (results.size() > 0)
+        for (size_t i = 0; i < results[0].deviceNames.size(); i++)
+            out << (i > 0 ? ", " : "") << jsonText(results[0].deviceNames[i]);
+    out << "],\n";
+    out << "  \"problems\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        size_t successes = 0;
+        for (double time : r.timesToTarget)
+            successes += std::isfinite(time) ? 1 : 0;
+
+        out << "    {\n";
+        out << "      \"problem\": " << jsonText(r.problem) << ",\n";
+        out << "      \"size\": " << r.size << ",\n";
+        out << "      \"parameters\": " << r.numParameters << ",\n";
+        out << "      \"objects\": " << r.numObjects << ",\n";
+        out << "      \"threadsPerObject\": " << r.threadsPerObject << ",\n";
+        out << "      \"targetEnergy\": " << jsonNumber(r.targetEnergy) << ",\n";
+        out << "      \"successRatio\": " << jsonNumber(successes / (double)r.timesToTarget.size()) << ",\n";
+        out << "      \"medianTimeToTargetSeconds\": " << jsonNumber(median(r.timesToTarget)) << ",\n";
+        out << "      \"timesToTargetSeconds\": [";
+        for (size_t k = 0; k < r.timesToTarget.size(); k++)
+            out << (k > 0 ? ", " : "") << jsonNumber(r.timesToTarget[k]);
+        out << "],\n";
+        out << "      \"medianFinalEnergy\": " << jsonNumber(median(r.finalEnergies)) << ",\n";
+        out << "      \"iterationsPerSecond\": " << jsonNumber(r.iterations / r.seconds) << ",\n";
+        out << "      \"bytesPerIteration\": " << jsonNumber(r.tracedIterations > 0 ? r.tracedBytes / r.tracedIterations : 0) << ",\n";
+        out << "      \"deviceUtilization\": [";
+        for (size_t d = 0; d < r.deviceNanoSeconds.size(); d++)
+            out << (d > 0 ? ", " : "") << jsonNumber(r.iterationNanoSeconds > 0 ? r.deviceNanoSeconds[d] / r.iterationNanoSeconds : 0);
+        out << "]\n";
+        out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// x in (-5.12, 5.12), minimum 0 at origin
+template<int D>
+BenchResult rastrigin(const BenchOptions& options, double targetEnergy)
+{
+    return benchmark<D, 256>("rastrigin", D, R"(
+        parallelFor(NumParameters,{
+            const float x = (parameters[loopId] - 0.5f) * 10.24f;
+            energy += 10.0f + x * x - 10.0f * cos(6.28318530718f * x);
+        });
+    )", [](UFSACL::UltraFastSimulatedAnnealing<D, 256>&) {}, targetEnergy, 1.0f, 0.001f, 1.2f, 3, options);
+}
+
+// x in (-2.048, 2.048), minimum 0 at (1, 1, ..., 1)
+template<int D>
+BenchResult rosenbrock(const BenchOptions& options, double targetEnergy)
+{
+    return benchmark<D, 256>("rosenbrock", D, R"(
+        parallelFor(NumParameters - 1,{
+            const float x = (parameters[loopId] - 0.5f) * 4.096f;
+            const float y = (parameters[loopId + 1] - 0.5f) * 4.096f;
+            energy += 100.0f * (y - x * x) * (y - x * x) + (1.0f - x) * (1.0f - x);
+        });
+    )", [](UFSACL::UltraFastSimulatedAnnealing<D, 256>&) {}, targetEnergy, 1.0f, 0.001f, 1.2f, 3, options);
+}
+
+// x in (-32.768, 32.768), minimum 0 at origin
+// both sums are needed before the non-linear combination so they are reduced over work-group and only first thread keeps the energy
+template<int D>
+BenchResult ackley(const BenchOptions& options, double targetEnergy)
+{
+    return benchmark<D, 256>("ackley", D, R"(
+        local float scratch[WorkGroupThreads];
+        float squares = 0.0f;
+        float cosines = 0.0f;
+        parallelFor(NumParameters,{
+            const float x = (parameters[loopId] - 0.5f) * 65.536f;
+            squares += x * x;
+            cosines += cos(6.28318530718f * x);
+        });
+        float sumSquares;
+        float sumCosines;
+        parallelReduce(scratch, squares, sumSquares);
+        parallelReduce(scratch, cosines, sumCosines);
+        if(threadId == 0)
+            energy = -20.0f * exp(-0.2f * sqrt(sumSquares / NumParameters)) - exp(sumCosines / NumParameters) + 20.0f + 2.71828182846f;
+    )", [](UFSACL::UltraFastSimulatedAnnealing<D, 256>&) {}, targetEnergy, 1.0f, 0.001f, 1.2f, 3, options);
+}
+
+// cubic polynomial fitted to sqrt(x) on N points of (0,1), coefficients in (-10, 10)
+template<int N>
+BenchResult polynomialFit(const BenchOptions& options)
+{
+    std::vector<float> dataPointsX;
+    std::vector<float> dataPointsY;
+    for (int i = 0; i < N; i++)
+    {
+        dataPointsX.push_back(i / (float)N);
+        dataPointsY.push_back(std::sqrt(i / (float)N));
+    }
+    return benchmark<4, 256>("polynomial-least-squares", N, std::string("#define NUM_POINTS ") + std::to_string(N) + R"(
+        parallelFor(NUM_POINTS,{
+            const float x = dataPointsX[loopId];
+            const float c0 = (parameters[0] - 0.5f) * 20.0f;
+            const float c1 = (parameters[1] - 0.5f) * 20.0f;
+            const float c2 = (parameters[2] - 0.5f) * 20.0f;
+            const float c3 = (parameters[3] - 0.5f) * 20.0f;
+            const float diff = (((c3 * x) + c2) * x + c1) * x + c0 - dataPointsY[loopId];
+            energy += diff * diff;
+        });
+    )", [&](UFSACL::UltraFastSimulatedAnnealing<4, 256>& sim) {
+            sim.addUserInput("dataPointsX", dataPointsX);
+            sim.addUserInput("dataPointsY", dataPointsY);
+        }, 0.002 * N, 1.0f, 0.001f, 1.2f, 3, options);
+}
+
+// cities are shuffled corners of a regular polygon so that shortest tour (perimeter) is known, target = 5% longer tour
+// tour is decoded from parameters as random keys: position of a city in tour = rank of its parameter
+template<int Cities>
+BenchResult travelingSalesman(const BenchOptions& options)
+{
+    std::mt19937 rng(Cities);
+    std::vector<int> order(Cities);
+    for (int i = 0; i < Cities; i++)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<float> cityX;
+    std::vector<float> cityY;
+    for (int i = 0; i < Cities; i++)
+    {
+        cityX.push_back((float)std::cos(6.28318530718 * order[i] / Cities));
+        cityY.push_back((float)std::sin(6.28318530718 * order[i] / Cities));
+    }
+    const double shortestTour = Cities * 2.0 * std::sin(3.14159265359 / Cities);
+    return benchmark<Cities, 256>("traveling-salesman", Cities, R"(
+        // each thread adds length of the edge from its city to the next city in tour
+        parallelFor(NumParameters,{
+            const float key = parameters[loopId];
+            int rank = 0;
+            for(int j = 0; j < NumParameters; j++)
+                rank += (parameters[j] < key || (parameters[j] == key && j < loopId)) ? 1 : 0;
+            const int nextRank = (rank + 1) % NumParameters;
+            for(int k = 0; k < NumParameters; k++)
+            {
+                int rankOfK = 0;
+                for(int j = 0; j < NumParameters; j++)
+                    rankOfK += (parameters[j] < parameters[k] || (parameters[j] == parameters[k] && j < k)) ? 1 : 0;
+                if(rankOfK == nextRank)
+                {
+                    const float dx = cityX[k] - cityX[loopId];
+                    const float dy = cityY[k] - cityY[loopId];
+                    energy += sqrt(dx * dx + dy * dy);
+                }
+            }
+        });
+    )", [&](UFSACL::UltraFastSimulatedAnnealing<Cities, 256>& sim) {
+            sim.addUserInput("cityX", cityX);
+            sim.addUserInput("cityY", cityY);
+        }, shortestTour * 1.05, 1.0f, 0.001f, 1.2f, 3, options);
+}
+
+// random upper-triangular qubo matrix, variable i is 1 when its parameter is above 0.5, target = exact minimum found by exhaustive search on host
+template<int Variables>
+BenchResult qubo(const BenchOptions& options)
+{
+    std::mt19937 rng(Variables);
+    std::uniform_real_distribution<float> coefficient(-1.0f, 1.0f);
+    std::vector<float> quboMatrix(Variables * Variables, 0.0f);
+    for (int i = 0; i < Variables; i++)
+        for (int j = i; j < Variables; j++)
+            quboMatrix[i * Variables + j] = coefficient(rng);
+
+    // gray-code enumeration: one variable flips per step, energy is updated by its row and column
+    std::vector<int> bits(Variables, 0);
+    double energy = 0;
+    double minimumEnergy = 0;
+    for (unsigned int step = 1; step < (1u << Variables); step++)
+    {
+        int flipped = 0;
+        while (((step >> flipped) & 1) == 0)
+            flipped++;
+        double delta = quboMatrix[flipped * Variables + flipped];
+        for (int j = 0; j < Variables; j++)
+            if (j != flipped && bits[j])
+                delta += quboMatrix[std::min(flipped, j) * Variables + std::max(flipped, j)];
+        energy += bits[flipped] ? -delta : delta;
+        bits[flipped] ^= 1;
+        minimumEnergy = std::min(minimumEnergy, energy);
+    }
+    return benchmark<Variables, 256>("qubo", Variables, R"(
+        parallelFor(NumParameters * NumParameters,{
+            const int i = loopId / NumParameters;
+            const int j = loopId - i * NumParameters;
+            if(parameters[i] > 0.5f && parameters[j] > 0.5f)
+                energy += quboMatrix[loopId];
+        });
+    )", [&](UFSACL::UltraFastSimulatedAnnealing<Variables, 256>& sim) {
+            sim.addUserInput("quboMatrix", quboMatrix);
+        }, minimumEnergy + 0.001, 1.0f, 0.001f, 1.2f, 3, options);
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        BenchOptions options;
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--cpu") == 0)
+                options.deviceSelection = GPGPU::Computer::DEVICE_CPUS;
+            else if (std::strcmp(argv[i], "--repeats") == 0 && i + 1 < argc)
+                options.repeats = std::max(1, std::atoi(argv[++i]));
+            else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+                options.outputPath = argv[++i];
+            else
+                throw std::invalid_argument(std::string("Error: unknown argument ") + argv[i] + ". usage: bench [--cpu] [--repeats N] [--output path.json]");
+        }
+
+        std::vector<BenchResult> results;
+        results.push_back(rastrigin<4>(options, 0.5));
+        results.push_back(rastrigin<16>(options, 10.0));
+        results.push_back(rosenbrock<4>(options, 0.1));
+        results.push_back(rosenbrock<16>(options, 5.0));
+        results.push_back(ackley<8>(options, 0.5));
+        results.push_back(ackley<32>(options, 2.0));
+        results.push_back(polynomialFit<1000>(options));
+        results.push_back(polynomialFit<20000>(options));
+        results.push_back(travelingSalesman<12>(options));
+        results.push_back(travelingSalesman<24>(options));
+        results.push_back(qubo<12>(options));
+        results.push_back(qubo<20>(options));
+
+        if (options.outputPath.size() > 0)
+        {
+            std::ofstream file(options.outputPath);
+            if (!file)
+                throw std::invalid_argument(std::string("Error: can not open ") + options.outputPath);
+            writeJson(file, results, options);
+        }
+        else
+            writeJson(std::cout, results, options);
+    }
+    catch (std::exception& ex)
+    {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -6,6 +6,20 @@ namespace GPGPU_LIB
 	CommandQueue::CommandQueue(Context con) :queue(con.context, con.device.device)
 	{
 		sharesRAM = con.device.sharesRAM;
+		bytesTransferred = 0;
+	}
+
+	CommandQueue::CommandQueue(const CommandQueue& other) :queue(other.queue), sharesRAM(other.sharesRAM), bytesTransferred(other.bytesTransferred.load())
+	{
+
+	}
+
+	CommandQueue& CommandQueue::operator=(const CommandQueue& other)
+	{
+		queue = other.queue;
+		sharesRAM = other.sharesRAM;
+		bytesTransferred = other.bytesTransferred.load();
+		return *this;
 	}
 
 	void CommandQueue::run(Kernel& kernel, size_t globalOffset, size_t nGlobal, size_t nLocal, size_t offset)
@@ -33,11 +47,35 @@ namespace GPGPU_LIB
 
 	void CommandQueue::copyInputsOfKernel(Kernel& kernel, size_t globalOffset, size_t offsetElement, size_t numElement)
 	{
+		// sharded inputs: shard of this device is written to start of its (shard-sized) buffer
+		// devices compute equal ranges of work-items so index of shard is index of range
+		for (auto& e : kernel.mapParameterNameToParameter)
+		{
+			if (e.second.readOp && e.second.shardElements > 0)
+			{
+				const size_t shardIndex = (globalOffset + offsetElement) / numElement;
+				const size_t hostOffset = shardIndex * e.second.shardElements * e.second.elementSize;
+				const size_t bytes = e.second.shardElements * e.second.elementSize;
+				cl_int op = queue.enqueueWriteBuffer(
+					e.second.buffer,
+					CL_FALSE,
+					0,
+					bytes,
+					e.second.hostPrm.quickPtr + hostOffset
+				);
+				if (op != CL_SUCCESS)
+				{
+					throw std::invalid_argument(std::string("enqueueWriteBuffer(shard) error: ") + getErrorString(op));
+				}
+				bytesTransferred += bytes;
+			}
+		}
+
 		if (!sharesRAM)
 		{
 			for (auto& e : kernel.mapParameterNameToParameter)
 			{				
-				if (e.second.readOp)
+				if (e.second.readOp && e.second.shardElements == 0)
 				{
 
 					cl_int op = queue.enqueueWriteBuffer(
@@ -54,6 +92,7 @@ namespace GPGPU_LIB
 					{
 						throw std::invalid_argument(std::string("enqueueReadBuffer error: ") + getErrorString(op));
 					}
+					bytesTransferred += e.second.readAll ? (e.second.elementSize * e.second.n) : (numElement * e.second.elementSize * e.second.elementsPerThread);
 				}
 			}
 		}
@@ -62,7 +101,7 @@ namespace GPGPU_LIB
 			for (auto& e : kernel.mapParameterNameToParameter)
 			{
 
-				if (e.second.readOp)
+				if (e.second.readOp && e.second.shardElements == 0)
 				{
 
 					cl_int op;
@@ -120,6 +159,7 @@ namespace GPGPU_LIB
 						err1 += std::string("num element = ") + std::to_string(numElement) + "\n";
 						throw std::invalid_argument(std::string("enqueueWriteBuffer-1 error: ") + getErrorString(op)+err1);
 					}
+					bytesTransferred += numElement * e.second.elementSize * e.second.elementsPerThread;
 				}
 			}
 		}
@@ -5,6 +5,7 @@
 #define GPGPU_COMMAND_QUEUE_LIB
 
 
+#include <atomic>
 #include "gpgpu_init.hpp"
 #include "context.h"
 #include "device.h"
@@ -18,9 +19,15 @@ namespace GPGPU_LIB
 	{
 		cl::CommandQueue queue;
 		bool sharesRAM;
+		// bytes copied between RAM and device since creation (mapped buffers of RAM-sharing devices are not counted)
+		// incremented by worker thread, read by other threads
+		std::atomic<size_t> bytesTransferred;
 		// requires a context to build
 		CommandQueue(Context con = Context());
 
+		CommandQueue(const CommandQueue& other);
+		CommandQueue& operator=(const CommandQueue& other);
+
 		// runs a kernel with globalOffset starting thread offset, nGlobal number of global threads, nLocal number of local threads, offset thread offset that is unique to current device
 		void run(Kernel& kernel, size_t globalOffset, size_t nGlobal, size_t nLocal, size_t offset);
 
@@ -120,6 +120,14 @@ namespace GPGPU
 
 
 	// binds a parameter to a kernel at parameterPosition-th position
+	void Computer::forgetParameterBindings(std::string parameterName)
+	{
+		for (auto& kernel : kernelParameters)
+		{
+			kernel.second.erase(parameterName);
+		}
+	}
+
 	void Computer::setKernelParameter(std::string kernelName, std::string parameterName, int parameterPosition)
 	{
 		// iterating 2 maps with several items should be faster than several threads to do something
@@ -402,13 +410,19 @@ namespace GPGPU
 	}
 
 	// applies load-balancing between calls
-	std::vector<double> Computer::runMultiple(std::vector<std::string> kernelNames, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads)
+	std::string Computer::multipleKernelName(const std::vector<std::string>& kernelNames)
 	{
 		std::string kernelName;
 		for (auto& str : kernelNames)
 		{
 			kernelName += (str + " ");
 		}
+		return kernelName;
+	}
+
+	std::vector<double> Computer::runMultiple(std::vector<std::string> kernelNames, size_t offsetElement, size_t numGlobalThreads, size_t numLocalThreads)
+	{
+		const std::string kernelName = multipleKernelName(kernelNames);
 		const int n = workers.size();
 		std::vector<double> nano(n);
 		if (loadBalances.find(kernelName) == loadBalances.end())
@@ -603,6 +617,38 @@ namespace GPGPU
 		return performancesOfDevices;
 	}
 
+	std::vector<double> Computer::computeSharded(
+		GPGPU::HostParameter prm,
+		std::string kernelName,
+		size_t numGlobalThreads,
+		size_t numLocalThreads)
+	{
+		const int n = workers.size();
+		if (numGlobalThreads == 0 || numGlobalThreads % (n * numLocalThreads) != 0)
+		{
+			throw std::invalid_argument("error: sharded compute needs global threads to be an integer-multiple of (number of devices x local threads)");
+		}
+
+		const int k = prm.prmList.size();
+		for (int i = 0; i < k; i++)
+		{
+			setKernelParameter(kernelName, prm.prmList[i], i);
+		}
+
+		// fixed ranges, shard of a device does not move
+		const size_t range = numGlobalThreads / n;
+		for (int i = 0; i < n; i++)
+		{
+			workers[i]->run(kernelName, 0, i * range, range, numLocalThreads);
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			workers[i]->waitAllTasks();
+		}
+		return std::vector<double>(n, 1.0 / n);
+	}
+
 	std::vector<double> Computer::computeMultiple(
 		std::vector<GPGPU::HostParameter> prms,
 		std::vector<std::string> kernelNames,
@@ -655,6 +701,38 @@ namespace GPGPU
 		return performancesOfDevices;
 	}
 
+	std::map<std::string, std::vector<std::vector<double>>> Computer::getLoadBalanceState()
+	{
+		std::map<std::string, std::vector<std::vector<double>>> state;
+		for (auto& lb : loadBalances)
+		{
+			std::vector<std::vector<double>> rows;
+			rows.push_back(lb.second);
+			for (auto& old : oldLoadBalances[lb.first])
+				rows.push_back(old);
+			state[lb.first] = rows;
+		}
+		return state;
+	}
+
+	void Computer::setLoadBalanceState(std::map<std::string, std::vector<std::vector<double>>> state)
+	{
+		const int n = workers.size();
+		for (auto& kernelState : state)
+		{
+			if (kernelState.second.size() == 0 || kernelState.second[0].size() != n)
+				continue;
+			loadBalances[kernelState.first] = kernelState.second[0];
+			std::vector<std::vector<double>> history;
+			for (int i = 1; i < kernelState.second.size(); i++)
+			{
+				if (kernelState.second[i].size() == n)
+					history.push_back(kernelState.second[i]);
+			}
+			oldLoadBalances[kernelState.first] = history;
+		}
+	}
+
 	std::vector<std::string> Computer::deviceNames(bool detailed)
 	{
 		std::vector<std::string> names;
@@ -667,4 +745,51 @@ namespace GPGPU
 		}
 		return names;
 	}
+
+	std::vector<double> Computer::lastComputeTimes(std::string kernelName)
+	{
+		std::vector<double> times;
+		for (int i = 0; i < workers.size(); i++)
+		{
+			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
+			auto it = workers[i]->benchmarks.find(kernelName);
+			times.push_back(it != workers[i]->benchmarks.end() ? it->second : 0);
+		}
+		return times;
+	}
+
+	std::vector<double> Computer::lastComputeTimes(std::vector<std::string> kernelNames)
+	{
+		const std::string stepName = multipleKernelName(kernelNames);
+		std::vector<double> times(workers.size(), 0);
+		for (int i = 0; i < workers.size(); i++)
+		{
+			std::unique_lock<std::mutex> lock(workers[i]->commonSync);
+			auto it = workers[i]->benchmarks.find(stepName);
+			if (kernelNames.size() > 1 && it != workers[i]->benchmarks.end())
+			{
+				times[i] = it->second;
+				continue;
+			}
+
+			// single kernel or fine-grained load-balancing (kernels run one by one)
+			for (auto& name : kernelNames)
+			{
+				auto itKernel = workers[i]->benchmarks.find(name);
+				if (itKernel != workers[i]->benchmarks.end())
+					times[i] += itKernel->second;
+			}
+		}
+		return times;
+	}
+
+	std::vector<size_t> Computer::transferredBytes()
+	{
+		std::vector<size_t> bytes;
+		for (int i = 0; i < workers.size(); i++)
+		{
+			bytes.push_back(workers[i]->queue.bytesTransferred.load());
+		}
+		return bytes;
+	}
 }
\ No newline at end of file
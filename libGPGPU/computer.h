@@ -35,6 +35,12 @@ namespace GPGPU
 
 		// kernel to parameters to position mapping
 		std::map<std::string, std::map<std::string, int>> kernelParameters;
+
+		// a parameter that is created again with same name has a new device buffer, kernels bind it again on their next compute
+		void forgetParameterBindings(std::string parameterName);
+
+		// name that a multi-kernel step is load-balanced and measured by
+		static std::string multipleKernelName(const std::vector<std::string>& kernelNames);
 		/*
 			deviceSelection = Computer::DEVICE_ALL ==> uses all gpu & cpu devices
 
@@ -75,6 +81,7 @@ namespace GPGPU
 		template<typename T>
 		HostParameter createHostParameter(std::string parameterName, size_t numElements, size_t numElementsPerThread, bool isInput, bool isOutput, bool isInputWithAllElements)
 		{
+			forgetParameterBindings(parameterName);
 			hostParameters[parameterName] = HostParameter(parameterName, numElements, sizeof(T), numElementsPerThread, isInput, isOutput, isInputWithAllElements);
 			for (int i = 0; i < workers.size(); i++)
 			{
@@ -83,6 +90,20 @@ namespace GPGPU
 			return hostParameters[parameterName];
 		}
 
+		// same as createHostParameter but uses caller's memory (4096-aligned) instead of allocating a new buffer (see HostParameter)
+		template<typename T>
+		HostParameter createHostParameterFromMemory(std::string parameterName, size_t numElements, size_t numElementsPerThread, bool isInput, bool isOutput, bool isInputWithAllElements, std::shared_ptr<T> memory)
+		{
+			std::shared_ptr<int8_t> bytes(memory, reinterpret_cast<int8_t*>(memory.get()));
+			forgetParameterBindings(parameterName);
+			hostParameters[parameterName] = HostParameter(parameterName, numElements, sizeof(T), numElementsPerThread, isInput, isOutput, isInputWithAllElements, bytes);
+			for (int i = 0; i < workers.size(); i++)
+			{
+				workers[i]->mirror(&hostParameters[parameterName]);
+			}
+			return hostParameters[parameterName];
+		}
+
 		// creates a single item - array on host side but a scalar on device side
 		template<typename T>
 		HostParameter createScalarInput(std::string parameterName)
@@ -98,6 +119,24 @@ namespace GPGPU
 			return createHostParameter<T>(parameterName, numElements, numElementsPerThread, true, false, true);
 		}
 
+		// creates input array from caller's memory without copying it on host side (if memory is 4096-aligned). All elements are copied to all devices (or directly used by devices that share RAM).
+		template<typename T>
+		HostParameter createArrayInputFromMemory(std::string parameterName, size_t numElements, std::shared_ptr<T> memory, size_t numElementsPerThread = 1)
+		{
+			return createHostParameterFromMemory<T>(parameterName, numElements, numElementsPerThread, true, false, true, memory);
+		}
+
+		// creates input array from a memory-mapped binary file (elements of type T, number of elements = file size / sizeof(T)). All elements are copied to all devices (or directly used by devices that share RAM).
+		template<typename T>
+		HostParameter createArrayInputFromFile(std::string parameterName, std::string path, size_t numElementsPerThread = 1)
+		{
+			size_t numBytes = 0;
+			std::shared_ptr<int8_t> bytes = mapFile(path, numBytes);
+			if (numBytes < sizeof(T))
+				throw std::invalid_argument(std::string("Error: file is smaller than a single element: ") + path);
+			return createHostParameterFromMemory<T>(parameterName, numBytes / sizeof(T), numElementsPerThread, true, false, true, std::shared_ptr<T>(bytes, reinterpret_cast<T*>(bytes.get())));
+		}
+
 		// creates input array. Devices get only their own elements.
 		// use for embarrassingly-parallel data where neighboring data elements are not required
 		template<typename T>
@@ -106,6 +145,25 @@ namespace GPGPU
 			return createHostParameter<T>(parameterName, numElements, numElementsPerThread, true, false, false);
 		}
 
+		// creates input array that is split into equal consecutive shards, one per device (numElements needs to be a multiple of number of devices)
+		// each device allocates and receives only its own shard, kernel accesses it starting from element 0
+		// only for computeSharded() where device i computes i-th equal part of work-items and receives i-th shard (shard size does not depend on work-items)
+		template<typename T>
+		HostParameter createArrayInputSharded(std::string parameterName, size_t numElements)
+		{
+			const int numShards = getNumDevices();
+			if (numElements == 0 || numElements % numShards != 0)
+				throw std::invalid_argument("Error: number of elements of sharded input needs to be a non-zero multiple of number of devices.");
+			forgetParameterBindings(parameterName);
+			hostParameters[parameterName] = HostParameter(parameterName, numElements, sizeof(T), 1, true, false, false);
+			hostParameters[parameterName].shardElements = numElements / numShards;
+			for (int i = 0; i < workers.size(); i++)
+			{
+				workers[i]->mirror(&hostParameters[parameterName]);
+			}
+			return hostParameters[parameterName];
+		}
+
 		// creates output array. Devices copy only their own elements to the output because of possible race-conditions
 		// works like createArrayInputLoadBalanced except for the output
 		template<typename T>
@@ -146,6 +204,14 @@ namespace GPGPU
 			bool fineGrainedLoadBalancing = false,
 			size_t fineGrainSize = 0);
 
+		// works like compute() without load-balancing: device i computes i-th equal part of work-items (for inputs created by createArrayInputSharded)
+		// numGlobalThreads needs to be a multiple of (number of devices x numLocalThreads)
+		std::vector<double> computeSharded(
+			GPGPU::HostParameter prm,
+			std::string kernelName,
+			size_t numGlobalThreads,
+			size_t numLocalThreads);
+
 		std::vector<double> computeMultiple(
 			std::vector<GPGPU::HostParameter> prm,
 			std::vector<std::string> kernelName,
@@ -157,6 +223,23 @@ namespace GPGPU
 
 		// returns list of device names with their opencl version support
 		std::vector<std::string> deviceNames(bool detailed = true);
+
+		// duration (nanoseconds) of last computation of a kernel on each device (same order as deviceNames())
+		std::vector<double> lastComputeTimes(std::string kernelName);
+
+		// duration (nanoseconds) of last computeMultiple() of kernels on each device
+		std::vector<double> lastComputeTimes(std::vector<std::string> kernelNames);
+
+		// bytes copied between RAM and each device since creation of this object (same order as deviceNames())
+		std::vector<size_t> transferredBytes();
+
+		/*
+			load-balancing state of each kernel: first row = current workload ratios of devices, other rows = history of device capabilities
+			can be saved and given back to another Computer object (or another process) with same devices to continue load-balancing from where it was
+			rows with different number of devices than this Computer object are ignored
+		*/
+		std::map<std::string, std::vector<std::vector<double>>> getLoadBalanceState();
+		void setLoadBalanceState(std::map<std::string, std::vector<std::vector<double>>> state);
 	};
 }
 #endif // !GPGPU_COMPUTER_LIB
\ No newline at end of file
@@ -1,9 +1,65 @@
 #include "parameter.h"
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace GPGPU
 {
 	struct Computer;
 
+	std::shared_ptr<int8_t> mapFile(std::string path, size_t& numBytes)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::invalid_argument(std::string("Error: could not open file ") + path);
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			throw std::invalid_argument(std::string("Error: could not get size of file (or file is empty) ") + path);
+		}
+		// copy-on-write view: host-side writes are private to this process
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+			throw std::invalid_argument(std::string("Error: could not map file ") + path);
+		void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+		if (view == nullptr)
+			throw std::invalid_argument(std::string("Error: could not map file ") + path);
+		numBytes = (size_t)fileSize.QuadPart;
+		return std::shared_ptr<int8_t>(reinterpret_cast<int8_t*>(view), [](int8_t* pt) { UnmapViewOfFile(pt); });
+#else
+		const int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			throw std::invalid_argument(std::string("Error: could not open file ") + path);
+		struct stat fileInfo;
+		if (fstat(file, &fileInfo) != 0 || fileInfo.st_size == 0)
+		{
+			close(file);
+			throw std::invalid_argument(std::string("Error: could not get size of file (or file is empty) ") + path);
+		}
+		const size_t size = (size_t)fileInfo.st_size;
+		// copy-on-write mapping: host-side writes are private to this process
+		void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		close(file);
+		if (view == MAP_FAILED)
+			throw std::invalid_argument(std::string("Error: could not map file ") + path);
+		numBytes = size;
+		return std::shared_ptr<int8_t>(reinterpret_cast<int8_t*>(view), [size](int8_t* pt) { munmap(pt, size); });
+#endif
+	}
+
 	HostParameter::HostParameter(
 		std::string parameterName,
 		size_t nElements,
@@ -19,7 +75,9 @@ namespace GPGPU
 		elementsPerThr(elementsPerThread),
 		readOp(read),
 		writeOp(write),
-		readAllOp(readAll)
+		readAllOp(readAll),
+		aliasOp(false),
+		shardElements(0)
 	{
 		// if a buffer is meant to be read-write in kernel, then it can not be read/written from host side for optimization reasons so use it as read=false write=false that means only device can access it.
 		if (read && write)
@@ -33,22 +91,73 @@ namespace GPGPU
 		}
 		else
 		{
-			// allocate buffer with enough padding for alignment and size restrictions of mapping/unmapping of OpenCL buffer
-			quickPtrVal = new int8_t[nElements * sizeElement + 4096 /* for re-alignment*/ + 4096 /* for zero-copy mapping CL_USE_HOST_PTR */];
-
-			// align buffer
-			size_t val = (size_t)quickPtrVal;
-			while ((val % 4096) != 0)
-			{
-				val++;
-			}
-
-			ptr = std::shared_ptr<int8_t>(quickPtrVal, [](int8_t* pt) { if (pt) delete[] pt; }); // last host parameter standing releases memory
-			quickPtr = reinterpret_cast<int8_t*>(val);
+			allocate();
+		}
+		prmList.push_back(parameterName);
+	}
+
+	HostParameter::HostParameter(
+		std::string parameterName,
+		size_t nElements,
+		size_t sizeElement,
+		size_t elementsPerThread,
+		bool read,
+		bool write,
+		bool readAll,
+		std::shared_ptr<int8_t> memory
+	) :
+		name(parameterName),
+		n(nElements),
+		elementSize(sizeElement),
+		elementsPerThr(elementsPerThread),
+		readOp(read),
+		writeOp(write),
+		readAllOp(readAll),
+		aliasOp(false),
+		shardElements(0)
+	{
+		if (read && write)
+		{
+			throw std::invalid_argument("Error: Buffer can not be both input and output at the same time. If kernel is meant to read/write this buffer arbitrarily, then use read=false write=false and access it within device freely as a state-management. This may also require an extra kernel to initialize the buffer.");
+		}
+
+		if (parameterName == "" || !memory)
+		{
+			throw std::invalid_argument("Error: Buffer that uses memory of caller needs a name and a valid memory pointer.");
+		}
+
+		if ((((size_t)memory.get()) % 4096) == 0)
+		{
+			// caller's memory is used as it is, shared pointer keeps it alive as long as any copy of this parameter exists
+			ptr = memory;
+			quickPtrVal = memory.get();
+			quickPtr = memory.get();
+			aliasOp = true;
+		}
+		else
+		{
+			allocate();
+			std::copy(memory.get(), memory.get() + (nElements * sizeElement), quickPtr);
 		}
 		prmList.push_back(parameterName);
 	}
 
+	void HostParameter::allocate()
+	{
+		// allocate buffer with enough padding for alignment and size restrictions of mapping/unmapping of OpenCL buffer
+		quickPtrVal = new int8_t[n * elementSize + 4096 /* for re-alignment*/ + 4096 /* for zero-copy mapping CL_USE_HOST_PTR */];
+
+		// align buffer
+		size_t val = (size_t)quickPtrVal;
+		while ((val % 4096) != 0)
+		{
+			val++;
+		}
+
+		ptr = std::shared_ptr<int8_t>(quickPtrVal, [](int8_t* pt) { if (pt) delete[] pt; }); // last host parameter standing releases memory
+		quickPtr = reinterpret_cast<int8_t*>(val);
+	}
+
 	HostParameter HostParameter::next(HostParameter prm)
 	{
 		HostParameter result = *this;
@@ -74,9 +183,11 @@ namespace GPGPU_LIB
 			readOp(hostParameter.readOp),
 			writeOp(hostParameter.writeOp),
 			readAll(hostParameter.readAllOp),
-			elementsPerThread(hostParameter.elementsPerThr)
+			elementsPerThread(hostParameter.elementsPerThr),
+			shardElements(hostParameter.shardElements)
 		{
-			bool sharesRAM = con.device.sharesRAM;
+			// sharded buffer is smaller than host buffer so it can not use host memory directly
+			bool sharesRAM = con.device.sharesRAM && (shardElements == 0);
 
 
 
@@ -95,7 +206,7 @@ namespace GPGPU_LIB
 
 				),
 
-				hostParameter.elementSize * hostParameter.n,
+				hostParameter.elementSize * (shardElements > 0 ? shardElements : hostParameter.n),
 
 				sharesRAM ? hostParameter.quickPtr : nullptr
 
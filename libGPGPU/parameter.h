@@ -41,6 +41,12 @@ namespace GPGPU
 		bool readOp;
 		bool writeOp;
 		bool readAllOp;
+		bool aliasOp;
+		// number of elements that each device holds when input is split between devices (0 = not sharded)
+		size_t shardElements;
+
+		// allocates aligned buffer of n elements
+		void allocate();
 	public:
 		HostParameter(
 			std::string parameterName = "",
@@ -52,6 +58,26 @@ namespace GPGPU
 			bool readAll = false
 		);
 
+		// uses memory of caller instead of allocating (zero-copy with CL_MEM_USE_HOST_PTR on devices that share RAM)
+		// memory is kept alive by this parameter (and its copies) through the shared pointer, use a no-op deleter for memory that is not owned
+		// if memory is not 4096-aligned, it is copied into a new aligned buffer instead
+		HostParameter(
+			std::string parameterName,
+			size_t nElements,
+			size_t sizeElement,
+			size_t elementsPerThread,
+			bool read,
+			bool write,
+			bool readAll,
+			std::shared_ptr<int8_t> memory
+		);
+
+		// true if the buffer is caller's memory instead of a copy
+		bool isAliasingMemory() const
+		{
+			return aliasOp;
+		}
+
 		// operator overloading from char buffer
 		template<typename T>
 		T& access(size_t index)
@@ -83,7 +109,7 @@ namespace GPGPU
 		// read region starting from ptrPrm and write to buffer
 		// numElements=0 means all elements are copied
 		template<typename T>
-		void copyDataFromPtr(T* ptrPrm, size_t numElements=0, size_t elementOffset=0)
+		void copyDataFromPtr(const T* ptrPrm, size_t numElements=0, size_t elementOffset=0)
 		{
 			elementOffset = (numElements == 0 ? 0 : elementOffset);
 			numElements = (numElements == 0 ? n : numElements);
@@ -102,6 +128,17 @@ namespace GPGPU
 			return elementSize;
 		}
 
+		const size_t getNumElements() const
+		{
+			return n;
+		}
+
+		// true if created by createArrayInputSharded
+		const bool isSharded() const
+		{
+			return shardElements > 0;
+		}
+
 		// sets all elements to the newValue value
 		template<typename T>
 		void operator = (const T& newValue)
@@ -130,9 +167,15 @@ namespace GPGPU
 			readOp=hPrm.readOp;
 			writeOp=hPrm.writeOp;
 			readAllOp=hPrm.readAllOp;
+			aliasOp=hPrm.aliasOp;
+			shardElements=hPrm.shardElements;
 		}
 
 	};
+
+	// maps a file into memory (copy-on-write, host-side writes are not written to file), mapping is released when last copy of the pointer is destroyed
+	// mapped memory is page-aligned (4096 bytes or more) so HostParameter can use it without copying and processes share the file's page-cache
+	std::shared_ptr<int8_t> mapFile(std::string path, size_t& numBytes);
 }
 
 namespace GPGPU_LIB
@@ -152,6 +195,8 @@ namespace GPGPU_LIB
 		bool readOp;
 		bool writeOp;
 		bool readAll;
+		// device buffer holds only shard of this device (starting at element 0 of buffer)
+		size_t shardElements;
 		Parameter(Context con = Context(), GPGPU::HostParameter hostParameter = GPGPU::HostParameter());
 	};
 
@@ -139,7 +139,8 @@ namespace GPGPU_LIB
 			{
 
 				std::unique_lock<std::mutex> lock(commonSync);
-				if (task.taskType == GPGPUTask::GPGPU_TASK_COMPUTE || task.taskType == GPGPUTask::GPGPU_TASK_COMPUTE_ALL)
+				// multi-kernel step is measured as a whole, by the joined name of its kernels
+				if (task.taskType == GPGPUTask::GPGPU_TASK_COMPUTE || task.taskType == GPGPUTask::GPGPU_TASK_COMPUTE_ALL || task.taskType == GPGPUTask::GPGPU_TASK_COMPUTE_MULTIPLE)
 				{
 					benchmarks[task.kernelName] = nanoLastCommand;
 					works[task.kernelName] = workLastCommand;
@@ -239,6 +240,7 @@ namespace GPGPU_LIB
 		if (multipleKernels)
 		{
 			task.taskType = GPGPUTask::GPGPU_TASK_COMPUTE_MULTIPLE;
+			task.kernelName = kernelName;
 			task.kernelNames = kernelNames;
 			task.offset = offset;
 			task.globalSize = numGlobal;